@@ -0,0 +1,154 @@
+#include "Autotune.h"
+
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+using namespace std::chrono;
+
+#include "ComputeUtil.h"
+#include "TileProfile.h"
+
+namespace {
+
+// Exposes InitArgsort, so argsort formats are tuned with their own kernels.
+class TunedSort : public SegmentedSortBase {
+public:
+    using SegmentedSortBase::SegmentedSortBase;
+    using SegmentedSortBase::InitArgsort;
+};
+
+struct Problem {
+    uint32_t count;
+    std::vector<uint32_t> segments;
+};
+
+void WaitForQueue(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    wgpu::Future done = device.GetQueue().OnSubmittedWorkDone(wgpu::CallbackMode::WaitAnyOnly, [](wgpu::QueueWorkDoneStatus) {});
+    instance->WaitAny(done, UINT64_MAX);
+}
+
+} // namespace
+
+SegmentedSortTile AutotuneSegmentedSort(
+  const std::unique_ptr<wgpu::Instance>& instance,
+  const wgpu::Device& device,
+  const SortFormat& format,
+  const AutotuneOptions& options,
+  std::vector<AutotuneResult>* results
+) {
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+
+    uint32_t maxCount = *std::max_element(options.counts.begin(), options.counts.end());
+    // Argsort formats read packed keys.
+    uint32_t recordBytes = format.argsort ? format.KeyWords() * sizeof(uint32_t) : format.ElementSize();
+
+    // Random words below 2^30 are positive, finite keys of every key type.
+    std::mt19937 mt;
+    std::uniform_int_distribution<uint32_t> word(0u, 0x3fffffffu);
+    std::vector<uint32_t> words(uint64_t(maxCount) * recordBytes / sizeof(uint32_t));
+    for (uint32_t& w : words) {
+      w = word(mt);
+    }
+
+    std::vector<Problem> problems;
+    uint32_t maxNumSegments = 1;
+    for (uint32_t count : options.counts) {
+      for (uint32_t length : options.segmentLengths) {
+        Problem problem;
+        problem.count = count;
+        problem.segments = ComputeUtil::fill_random_cpu(0u, count - 1, std::max(1u, count / length), true);
+        maxNumSegments = std::max<uint32_t>(maxNumSegments, problem.segments.size());
+        problems.push_back(problem);
+      }
+    }
+
+    // Every sort starts from the same unsorted input, copied from pristine.
+    wgpu::Buffer pristine = utils::CreateBuffer(device, uint64_t(maxCount) * recordBytes,
+      wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "Autotune::pristine");
+    wgpu::Buffer input = utils::CreateBuffer(device, uint64_t(maxCount) * recordBytes,
+      wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc | wgpu::BufferUsage::CopyDst, "Autotune::input");
+    wgpu::Buffer segments = utils::CreateBuffer(device, maxNumSegments * sizeof(uint32_t),
+      wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "Autotune::segments");
+    device.GetQueue().WriteBuffer(pristine, 0, words.data(), words.size() * sizeof(uint32_t));
+
+    std::vector<SegmentedSortTile> tiles;
+    for (uint32_t nt : options.nts) {
+      for (uint32_t vt : options.vts) {
+        for (uint32_t nt2 : options.nt2s) {
+          tiles.push_back({ nt, vt, nt2 });
+        }
+      }
+    }
+    SegmentedSortTile largest = SegmentedSortBase::LargestTile(format, limits.limits);
+    auto isLargest = [&](const SegmentedSortTile& t) { return t.nt == largest.nt && t.vt == largest.vt && t.nt2 == largest.nt2; };
+    if (std::none_of(tiles.begin(), tiles.end(), isLargest)) {
+      tiles.push_back(largest);
+    }
+
+    std::vector<AutotuneResult> timings;
+    for (const SegmentedSortTile& tile : tiles) {
+      if (!SegmentedSortBase::TileFits(tile, format, limits.limits)) {
+        continue;
+      }
+
+      TunedSort sorter(format);
+      sorter.SetTile(tile);
+      if (format.argsort) {
+        sorter.InitArgsort(device, input, maxCount, segments, maxNumSegments);
+      } else {
+        sorter.Init(device, input, maxCount, segments, maxNumSegments);
+      }
+
+      double total = 0.0;
+      for (const Problem& problem : problems) {
+        uint32_t numSegments = problem.segments.size();
+        device.GetQueue().WriteBuffer(segments, 0, problem.segments.data(), numSegments * sizeof(uint32_t));
+        if (!sorter.Upload(device, problem.count, numSegments)) {
+          std::cerr << "Autotune: problems of " << problem.count << " records do not fit the device" << std::endl;
+          exit(1);
+        }
+
+        // The first sort warms up and is not timed.
+        std::vector<double> times;
+        for (uint32_t it = 0; it <= options.iterations; it++) {
+          wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+          encoder.CopyBufferToBuffer(pristine, 0, input, 0, uint64_t(problem.count) * recordBytes);
+          sorter.Sort(encoder, wgpu::QuerySet(), problem.count, numSegments);
+          wgpu::CommandBuffer commandBuffer = encoder.Finish();
+          WaitForQueue(instance, device);
+
+          auto t0 = high_resolution_clock::now();
+          device.GetQueue().Submit(1, &commandBuffer);
+          WaitForQueue(instance, device);
+          auto t1 = high_resolution_clock::now();
+
+          if (it > 0) {
+            times.push_back(duration_cast<nanoseconds>(t1 - t0).count() / 1e6);
+          }
+        }
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        total += times[times.size() / 2];
+      }
+      sorter.Dispose();
+
+      timings.push_back({ tile, total });
+    }
+
+    pristine.Destroy();
+    input.Destroy();
+    segments.Destroy();
+
+    if (timings.empty()) {
+      std::cerr << "Autotune: no tile of the grid fits the device for " << format.Name() << std::endl;
+      exit(1);
+    }
+
+    std::stable_sort(timings.begin(), timings.end(), [](const AutotuneResult& a, const AutotuneResult& b) { return a.ms < b.ms; });
+    TileProfile::Store(device.GetAdapter(), format, timings.front().tile);
+    if (results) {
+      *results = timings;
+    }
+    return timings.front().tile;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <webgpu/webgpu_cpp.h>
+#include "SegSort.h"
+
+struct AutotuneOptions {
+  // Grid of tiles to benchmark, the ones that do not fit the device are skipped.
+  // The LargestTile of the device is benchmarked as well.
+  std::vector<uint32_t> nts = { 64, 128, 256 };
+  std::vector<uint32_t> vts = { 7, 11, 15, 19, 23 };
+  std::vector<uint32_t> nt2s = { 32, 64, 128 };
+  // Representative problems: every count is sorted with segments of every
+  // average length.
+  std::vector<uint32_t> counts = { 1u << 18, 1u << 21 };
+  std::vector<uint32_t> segmentLengths = { 100, 5000 };
+  // Timed sorts per problem, the median counts.
+  uint32_t iterations = 7;
+};
+
+struct AutotuneResult {
+  SegmentedSortTile tile;
+  // Sum of the median sort times of the problems.
+  double ms;
+};
+
+// Benchmarks SegmentedSort of format with every tile of the grid that fits the
+// device and stores the fastest in the tile profile of the adapter, see
+// TileProfile. Results of all tiles, fastest first, go to results when given.
+// Every tile compiles its own pipelines, so a full grid takes a while.
+SegmentedSortTile AutotuneSegmentedSort(
+  const std::unique_ptr<wgpu::Instance>& instance,
+  const wgpu::Device& device,
+  const SortFormat& format,
+  const AutotuneOptions& options = AutotuneOptions(),
+  std::vector<AutotuneResult>* results = nullptr
+);
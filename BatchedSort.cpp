@@ -0,0 +1,114 @@
+#include "BatchedSort.h"
+
+#include <cstring>
+
+#include "ComputeUtil.h"
+
+BatchedSortBase::BatchedSortBase(const SortFormat& format) : sorter(format), elementSize(format.ElementSize()) {}
+
+void BatchedSortBase::Init(const wgpu::Device& device, uint32_t maxCount, uint32_t maxNumSegments) {
+    this->maxCount = std::max(maxCount, 1u);
+    this->maxNumSegments = std::max(maxNumSegments, 1u);
+
+    recordsBuffer = utils::CreateBuffer(device, uint64_t(this->maxCount) * elementSize, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "BatchedSort::records");
+    segmentsBuffer = utils::CreateBuffer(device, this->maxNumSegments * sizeof(uint32_t), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "BatchedSort::segments");
+
+    sorter.Init(device, recordsBuffer, this->maxCount, segmentsBuffer, this->maxNumSegments);
+}
+
+uint32_t BatchedSortBase::Add(
+  const void* data,
+  uint32_t count,
+  const uint32_t* segments,
+  uint32_t segmentCount,
+  const wgpu::Buffer& destination,
+  uint64_t destinationOffset
+) {
+    uint32_t offset = static_cast<uint32_t>(records.size() / elementSize);
+    if (uint64_t(offset) + count > UINT32_MAX) {
+      std::cerr << "BatchedSort: a batch holds at most " << UINT32_MAX << " records" << std::endl;
+      exit(1);
+    }
+
+    records.resize(records.size() + size_t(count) * elementSize);
+    std::memcpy(records.data() + size_t(offset) * elementSize, data, size_t(count) * elementSize);
+
+    // Heads at 0 are implicit, empty arrays add none.
+    if (offset > 0 && count > 0) {
+      heads.push_back(offset);
+    }
+    for (uint32_t i = 0; i < segmentCount; i++) {
+      if (segments[i] > 0 && segments[i] < count) {
+        heads.push_back(offset + segments[i]);
+      }
+    }
+
+    uint32_t index = static_cast<uint32_t>(ranges.size());
+    ranges.push_back({ offset, count });
+    maxArrayLength = std::max(maxArrayLength, count);
+    if (destination && count > 0) {
+      destinations.push_back({ index, destination, destinationOffset });
+    }
+    return index;
+}
+
+void BatchedSortBase::Reserve(const wgpu::Device& device) {
+    uint32_t count = static_cast<uint32_t>(records.size() / elementSize);
+    uint32_t numSegments = static_cast<uint32_t>(heads.size());
+    if (count <= maxCount && numSegments <= maxNumSegments) {
+      return;
+    }
+
+    if (count > maxCount) {
+      maxCount = std::max(count, static_cast<uint32_t>(maxCount * 1.5f));
+      recordsBuffer.Destroy();
+      recordsBuffer = utils::CreateBuffer(device, uint64_t(maxCount) * elementSize, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "BatchedSort::records");
+    }
+    if (numSegments > maxNumSegments) {
+      maxNumSegments = std::max(numSegments, static_cast<uint32_t>(maxNumSegments * 1.5f));
+      segmentsBuffer.Destroy();
+      segmentsBuffer = utils::CreateBuffer(device, maxNumSegments * sizeof(uint32_t), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "BatchedSort::segments");
+    }
+    sorter.SetBuffers(recordsBuffer, segmentsBuffer);
+}
+
+void BatchedSortBase::Sort(const wgpu::Device& device, const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet) {
+    uint32_t count = static_cast<uint32_t>(records.size() / elementSize);
+    if (count == 0) {
+      return;
+    }
+
+    Reserve(device);
+
+    auto queue = device.GetQueue();
+    queue.WriteBuffer(recordsBuffer, 0, records.data(), records.size());
+    if (!heads.empty()) {
+      queue.WriteBuffer(segmentsBuffer, 0, heads.data(), heads.size() * sizeof(uint32_t));
+    }
+
+    // Small arrays take the segmented radix path when the adapter supports it.
+    if (!sorter.Upload(device, count, heads.size())) {
+      std::cerr << "BatchedSort: a batch of " << count << " records does not fit the device" << std::endl;
+      exit(1);
+    }
+    sorter.Sort(encoder, querySet, count, heads.size(), maxArrayLength);
+
+    for (const Destination& destination : destinations) {
+      const Range& range = ranges[destination.array];
+      encoder.CopyBufferToBuffer(recordsBuffer, uint64_t(range.offset) * elementSize, destination.buffer, destination.offset, uint64_t(range.count) * elementSize);
+    }
+}
+
+void BatchedSortBase::Reset() {
+    records.clear();
+    heads.clear();
+    ranges.clear();
+    destinations.clear();
+    maxArrayLength = 0;
+}
+
+void BatchedSortBase::Dispose() {
+    sorter.Dispose();
+    recordsBuffer.Destroy();
+    segmentsBuffer.Destroy();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+#include "SegSort.h"
+
+// Sorts many independent arrays with one SegmentedSort encode. The arrays are
+// packed back to back into one buffer and every array start becomes a segment
+// head, so no records cross between arrays. Arrays may carry segment heads of
+// their own, relative to their first record. Results stay at the offset of the
+// array in ResultBuffer() or are copied to a destination given to Add.
+class BatchedSortBase {
+public:
+    struct Range {
+      uint32_t offset;
+      uint32_t count;
+    };
+
+    explicit BatchedSortBase(const SortFormat& format);
+
+    void Dispose();
+    // The sizes are only the initial capacity, the buffers grow with the batches.
+    void Init(const wgpu::Device& device, uint32_t maxCount, uint32_t maxNumSegments);
+
+    // Appends an array to the batch and returns its index. With a destination the
+    // sorted array is copied there at destinationOffset after the sort.
+    uint32_t Add(
+      const void* records,
+      uint32_t count,
+      const uint32_t* segments = nullptr,
+      uint32_t segmentCount = 0,
+      const wgpu::Buffer& destination = wgpu::Buffer(),
+      uint64_t destinationOffset = 0
+    );
+
+    // Uploads the batch and encodes its sort and the copies to the destinations.
+    void Sort(const wgpu::Device& device, const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet);
+    // Empties the batch, the previous results stay in ResultBuffer() until the
+    // next Sort.
+    void Reset();
+
+    uint32_t Size() const { return static_cast<uint32_t>(ranges.size()); }
+    // Records of array i in ResultBuffer().
+    Range GetRange(uint32_t i) const { return ranges[i]; }
+    const wgpu::Buffer& ResultBuffer() const { return recordsBuffer; }
+
+private:
+    struct Destination {
+      uint32_t array;
+      wgpu::Buffer buffer;
+      uint64_t offset;
+    };
+
+    // Grows the packed buffers to fit the current batch.
+    void Reserve(const wgpu::Device& device);
+
+    SegmentedSortBase sorter;
+    uint32_t elementSize;
+    uint32_t maxCount;
+    uint32_t maxNumSegments;
+
+    std::vector<uint8_t> records;
+    std::vector<uint32_t> heads;
+    std::vector<Range> ranges;
+    std::vector<Destination> destinations;
+    // Longest array, which bounds the segment lengths.
+    uint32_t maxArrayLength = 0;
+
+    wgpu::Buffer recordsBuffer;
+    wgpu::Buffer segmentsBuffer;
+};
+
+template <typename Key = uint32_t, typename Value = uint32_t>
+class BatchedSort : public BatchedSortBase {
+public:
+    using Record = SortElement<Key, Value>;
+
+    explicit BatchedSort(SortOrder order = SortOrder::Ascending)
+        : BatchedSortBase(MakeSortFormat<Key, Value>(order)) {}
+
+    uint32_t Add(std::span<const Record> records, std::span<const uint32_t> segments = {},
+                 const wgpu::Buffer& destination = wgpu::Buffer(), uint64_t destinationOffset = 0) {
+        return BatchedSortBase::Add(records.data(), records.size(), segments.data(), segments.size(), destination, destinationOffset);
+    }
+};
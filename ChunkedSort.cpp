@@ -0,0 +1,94 @@
+#include "ChunkedSort.h"
+
+#include <cstring>
+
+#include "ComputeUtil.h"
+#include "KWayMerge.h"
+
+void ChunkedSort::Init(const wgpu::Device& device, uint32_t chunkSize) {
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+
+    // The keys and the scratch buffer of RadixSort are bound whole, and its
+    // look-back status words hold 29 bit counts.
+    uint64_t maxBytes = std::min<uint64_t>(limits.limits.maxStorageBufferBindingSize, limits.limits.maxBufferSize);
+    uint32_t maxChunkSize = static_cast<uint32_t>(std::min<uint64_t>(maxBytes / sizeof(uint32_t), 1u << 29));
+    if (chunkSize > maxChunkSize) {
+      std::cerr << "ChunkedSort: chunks of " << chunkSize << " keys exceed the storage buffer limits" << std::endl;
+      exit(1);
+    }
+    this->chunkSize = chunkSize == 0 ? maxChunkSize : chunkSize;
+
+    uint64_t byteSize = uint64_t(this->chunkSize) * sizeof(uint32_t);
+    keysBuffer = utils::CreateBuffer(device, byteSize, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "ChunkedSort::keys");
+    readbackBuffer = utils::CreateBuffer(device, byteSize, wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead, "ChunkedSort::readback");
+
+    sorter.Init(device, keysBuffer, this->chunkSize);
+}
+
+void ChunkedSort::Sort(const wgpu::Device& device, std::vector<uint32_t>& data) {
+    size_t count = data.size();
+    if (count <= 1) {
+      return;
+    }
+
+    for (size_t offset = 0; offset < count; offset += chunkSize) {
+      uint32_t chunkCount = static_cast<uint32_t>(std::min<size_t>(chunkSize, count - offset));
+      SortChunk(device, data.data() + offset, chunkCount);
+    }
+
+    if (count <= chunkSize) {
+      return;
+    }
+
+    std::vector<uint32_t> output(count);
+    MergeRuns(data, chunkSize, output);
+    data.swap(output);
+}
+
+void ChunkedSort::SortChunk(const wgpu::Device& device, uint32_t* keys, uint32_t count) {
+    uint64_t byteSize = uint64_t(count) * sizeof(uint32_t);
+    auto queue = device.GetQueue();
+    queue.WriteBuffer(keysBuffer, 0, keys, byteSize);
+    sorter.Upload(device, count);
+
+    wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+    sorter.Sort(encoder, wgpu::QuerySet(), count);
+    encoder.CopyBufferToBuffer(keysBuffer, 0, readbackBuffer, 0, byteSize);
+    wgpu::CommandBuffer commandBuffer = encoder.Finish();
+    queue.Submit(1, &commandBuffer);
+
+    WGPUBufferMapAsyncStatus readStatus = WGPUBufferMapAsyncStatus_Unknown;
+    readbackBuffer.MapAsync(
+        wgpu::MapMode::Read, 0, byteSize,
+        [](WGPUBufferMapAsyncStatus status, void* userdata) { *static_cast<WGPUBufferMapAsyncStatus*>(userdata) = status; }, &readStatus);
+
+    while (readStatus == WGPUBufferMapAsyncStatus_Unknown) {
+      device.Tick();
+      std::this_thread::sleep_for(std::chrono::microseconds{50});
+    }
+
+    if (readStatus != WGPUBufferMapAsyncStatus_Success) {
+      std::cerr << "ChunkedSort: failed to read back a chunk, with status: " << static_cast<int>(readStatus) << std::endl;
+      exit(1);
+    }
+
+    std::memcpy(keys, readbackBuffer.GetConstMappedRange(0, byteSize), byteSize);
+    readbackBuffer.Unmap();
+}
+
+// Merges the sorted runs of runLength keys in data, the last run may be shorter.
+void ChunkedSort::MergeRuns(const std::vector<uint32_t>& data, size_t runLength, std::vector<uint32_t>& output) {
+    size_t out = 0;
+    KWayMerge(data.data(), data.size(), runLength, [](uint32_t key) { return key; },
+              [&](const uint32_t* first, size_t n) {
+                std::copy(first, first + n, output.begin() + out);
+                out += n;
+              });
+}
+
+void ChunkedSort::Dispose() {
+    sorter.Dispose();
+    keysBuffer.Destroy();
+    readbackBuffer.Destroy();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <chrono>
+using namespace std::chrono;
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+#include "RadixSort.h"
+
+// Out-of-core sort of u32 keys for inputs larger than a storage buffer binding.
+// The input is cut into chunks that fit, every chunk is sorted on the GPU by
+// RadixSort and read back in place as a sorted run, then the runs are merged on
+// the CPU with a k-way merge.
+class ChunkedSort {
+public:
+    void Dispose();
+    // A chunkSize of 0 uses the largest chunk the device limits allow.
+    void Init(const wgpu::Device& device, uint32_t chunkSize = 0);
+
+    // Sorts data in place, data may hold any number of keys.
+    void Sort(const wgpu::Device& device, std::vector<uint32_t>& data);
+
+    uint32_t ChunkSize() const { return chunkSize; }
+private:
+    // Sorts the count keys at keys on the GPU and writes them back sorted.
+    void SortChunk(const wgpu::Device& device, uint32_t* keys, uint32_t count);
+    static void MergeRuns(const std::vector<uint32_t>& data, size_t runLength, std::vector<uint32_t>& output);
+
+    uint32_t chunkSize;
+
+    RadixSort sorter;
+    wgpu::Buffer keysBuffer;
+    wgpu::Buffer readbackBuffer;
+};
@@ -1,4 +1,5 @@
 #include "ComputeUtil.h"
+#include "PipelineLibrary.h"
 
 // #include "src/util/FileUtil.h"
 // #include "src/2d/renderer/HotReloadShader.h"
@@ -14,19 +15,33 @@ namespace ComputeUtil  {
       const wgpu::Device& device, 
       const wgpu::BindGroupLayout& bgl, 
       const std::string& shader,
-      const char* label) {
+      const char* label,
+      const PipelineConstants& constants) {
     wgpu::ShaderModule shaderModule = utils::CreateShaderModule(device, shader.c_str(), label);
     wgpu::PipelineLayout pl = utils::MakeBasicPipelineLayout(device, &bgl);
+    std::vector<wgpu::ConstantEntry> entries = MakeConstantEntries(constants);
     wgpu::ComputePipelineDescriptor csDesc;
     csDesc.layout = pl;
     csDesc.compute.module = shaderModule;
     csDesc.compute.entryPoint = "main";
     csDesc.label = label;
-    // Needed for emscripten
-    csDesc.compute.constantCount = 0;
+    // Needed for emscripten when there are none
+    csDesc.compute.constantCount = entries.size();
+    csDesc.compute.constants = entries.empty() ? nullptr : entries.data();
     return device.CreateComputePipeline(&csDesc);
   }
 
+  std::vector<wgpu::ConstantEntry> MakeConstantEntries(const PipelineConstants& constants) {
+    std::vector<wgpu::ConstantEntry> entries;
+    for (const auto& [name, value] : constants) {
+      wgpu::ConstantEntry entry;
+      entry.key = name.c_str();
+      entry.value = value;
+      entries.push_back(entry);
+    }
+    return entries;
+  }
+
     inline std::mt19937& get_mt19937() {
         static std::mt19937 mt19937;
         return mt19937;
@@ -65,6 +80,16 @@ namespace ComputeUtil  {
         }
         return data;
     }
+    std::vector<uint32_t> fill_random_segments(uint32_t count, uint32_t maxLength) {
+        std::uniform_int_distribution<uint32_t> d(1, maxLength);
+        std::vector<uint32_t> heads;
+
+        for (uint32_t head = d(get_mt19937()); head < count; head += d(get_mt19937())) {
+            heads.push_back(head);
+        }
+        return heads;
+    }
+
     // Count leading zeros
     int clz(int x) {
         for(int i = 31; i >= 0; --i)
@@ -93,12 +118,45 @@ namespace ComputeUtil  {
         PrintRange(pvec, 0, pvec.size(), newLineCount);
     }
 
+  void PipelineBatch::Add(
+      const wgpu::Device& device, 
+      const wgpu::BindGroupLayout& bgl, 
+      const std::string& shader,
+      const char* label,
+      wgpu::ComputePipeline* target,
+      const PipelineConstants& constants) {
+    PipelineLibrary::Get(device)->Request(bgl, shader, label, target, pending, &futures, constants);
+  }
+
+  wgpu::BindGroupLayout PipelineBatch::Layout(
+      const wgpu::Device& device,
+      const char* label,
+      const std::vector<utils::BindingLayoutEntryInitializationHelper>& entries) const {
+    return PipelineLibrary::Get(device)->Layout(label, entries);
+  }
+
+  void PipelineBatch::Wait(const wgpu::Device& device) const {
+    wgpu::Instance instance = device.GetAdapter().GetInstance();
+    for (const wgpu::Future& future : futures) {
+      instance.WaitAny(future, UINT64_MAX);
+    }
+    // A compile completed by another batch's wait may still be handing out
+    // its pipeline on that thread.
+    while (!Done()) {
+      std::this_thread::yield();
+    }
+  }
+
     void BusyWaitDevice(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
         auto c = device.GetQueue().OnSubmittedWorkDone(wgpu::CallbackMode::AllowProcessEvents, [](wgpu::QueueWorkDoneStatus status) {});
         instance->WaitAny(c, 0);
     }
     
     wgpu::ComputePassEncoder CreateTimestampedComputePass(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t index) {
+      if (!querySet) {
+        return encoder.BeginComputePass();
+      }
+
     wgpu::ComputePassTimestampWrites writes;
       writes.beginningOfPassWriteIndex = index * 2u;
       writes.endOfPassWriteIndex = index * 2u + 1u;
@@ -108,6 +166,18 @@ namespace ComputeUtil  {
       descriptor.timestampWrites = &writes;
       return encoder.BeginComputePass(&descriptor);
     }
+
+    void DispatchLinear(const wgpu::ComputePassEncoder& pass, uint32_t numWorkgroups) {
+      const uint32_t maxWorkgroupsPerDimension = 0xffffu;
+      if (numWorkgroups <= maxWorkgroupsPerDimension) {
+        pass.DispatchWorkgroups(numWorkgroups);
+        return;
+      }
+
+      uint32_t y = div_up(numWorkgroups, maxWorkgroupsPerDimension);
+      uint32_t x = div_up(numWorkgroups, y);
+      pass.DispatchWorkgroups(x, y);
+    }
 }
 
 
@@ -1,14 +1,20 @@
 #pragma once
 
 #include "wgpu/WGPUHelpers.h"
+#include "SortTypes.h"
 // #include "src/util/ImageUtil.h"
 #include <random>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <limits>
+#include <type_traits>
 
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <map>
 
 struct int2 {
   int32_t x;
@@ -44,8 +50,9 @@ std::vector<T> ReadBackBuffer(const wgpu::Device& device, const wgpu::Buffer& fr
 
     if (readStatus == WGPUBufferMapAsyncStatus_Success) {
         const T* data = static_cast<const T*>(fromBuffer.GetConstMappedRange());
+        std::vector<T> result(data, data + byteSize / sizeof(T));
         fromBuffer.Unmap();
-        return {&data[0], &data[byteSize / sizeof(T)]};
+        return result;
     }
 
     std::cerr << "Failed to read back buffer, with status:" << static_cast<int>(readStatus) << std::endl;
@@ -78,15 +85,63 @@ template <typename T>
     return vv;
   }
 
+  // Without a query set the pass is not timed.
   wgpu::ComputePassEncoder CreateTimestampedComputePass(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t index);
 
+  // Dispatches numWorkgroups workgroups, folded into a 2D grid when it exceeds the
+  // per-dimension limit. Kernels recover the linear index as
+  // workgroup_id.y * num_workgroups.x + workgroup_id.x and skip indices past the end.
+  void DispatchLinear(const wgpu::ComputePassEncoder& pass, uint32_t numWorkgroups);
+
+  // Values of the pipeline-overridable constants of a shader, by name. Ordered, so
+  // equal sets serialize equally.
+  using PipelineConstants = std::map<std::string, double>;
+
   wgpu::ComputePipeline CreatePipeline(
     const wgpu::Device& device, 
     const wgpu::BindGroupLayout& bgl, 
     const std::string& shader,
-    const char* label
+    const char* label,
+    const PipelineConstants& constants = {}
   ); 
 
+  // constants as the entries of a ComputePipelineDescriptor, which refer to the
+  // names in constants.
+  std::vector<wgpu::ConstantEntry> MakeConstantEntries(const PipelineConstants& constants);
+
+  // Creates pipelines through CreateComputePipelineAsync, so the shaders added to
+  // a batch compile concurrently. Each pipeline is written to its target once it
+  // is created, the targets must stay valid until the batch is done. Variants
+  // that another batch on the device already built come from its PipelineLibrary.
+  class PipelineBatch {
+  public:
+    void Add(
+      const wgpu::Device& device, 
+      const wgpu::BindGroupLayout& bgl, 
+      const std::string& shader,
+      const char* label,
+      wgpu::ComputePipeline* target,
+      const PipelineConstants& constants = {}
+    );
+
+    // The bind group layout with entries from the PipelineLibrary of device,
+    // shared by every sorter on the device that asks for the same entries.
+    wgpu::BindGroupLayout Layout(
+      const wgpu::Device& device,
+      const char* label,
+      const std::vector<utils::BindingLayoutEntryInitializationHelper>& entries
+    ) const;
+
+    bool Done() const { return *pending == 0; }
+    // Blocks in Instance::WaitAny until every pipeline of the batch is created.
+    void Wait(const wgpu::Device& device) const;
+
+  private:
+    std::shared_ptr<std::atomic<uint32_t>> pending = std::make_shared<std::atomic<uint32_t>>(0);
+    // The compiles the targets wait for, including those other batches started.
+    std::vector<wgpu::Future> futures;
+  };
+
 
   inline std::mt19937& get_mt19937();
 
@@ -104,6 +159,32 @@ template <typename T>
     size_t count
   );
 
+  template <typename T>
+  T random_value(std::mt19937& mt) {
+    if constexpr (std::is_floating_point_v<T>) {
+      return std::uniform_real_distribution<T>(-1e6, 1e6)(mt);
+    } else {
+      return std::uniform_int_distribution<T>(std::numeric_limits<T>::min(), std::numeric_limits<T>::max())(mt);
+    }
+  }
+
+  template <typename Key, typename Value>
+  std::vector<SortElement<Key, Value>> fill_random_records(size_t count) {
+    static std::mt19937 mt;
+    std::vector<SortElement<Key, Value>> data(count);
+
+    for (SortElement<Key, Value>& r : data) {
+      if constexpr (std::is_same_v<Value, KeyOnly>) {
+        r = random_value<Key>(mt);
+      } else {
+        r.key = random_value<Key>(mt);
+        r.value = random_value<Value>(mt);
+      }
+    }
+
+    return data;
+  }
+
   std::vector<uint32_t> fill_random_cpu(
     uint32_t a, 
     uint32_t b, 
@@ -111,6 +192,12 @@ template <typename T>
     bool sorted = false
   );
 
+  // Sorted segment heads (excluding 0) of segments with random lengths in [1, maxLength].
+  std::vector<uint32_t> fill_random_segments(
+    uint32_t count, 
+    uint32_t maxLength
+  );
+
   // Count leading zeros
   int clz(int x);
   constexpr bool is_pow2(int x);
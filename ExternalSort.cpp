@@ -0,0 +1,236 @@
+#include "ExternalSort.h"
+
+#include <future>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ComputeUtil.h"
+#include "KWayMerge.h"
+
+// Writes size bytes at offset, pwrite may write less than asked for.
+static void WriteAll(int fd, const void* data, size_t size, size_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+      ssize_t written = pwrite(fd, bytes, size, offset);
+      if (written < 0) {
+        std::cerr << "ExternalSort: write failed: " << std::strerror(errno) << std::endl;
+        exit(1);
+      }
+      bytes += written;
+      size -= written;
+      offset += written;
+    }
+}
+
+// Maps size bytes of buffer and waits for it. Mapping also waits for the
+// submitted commands that use the buffer.
+static void MapAndWait(const wgpu::Device& device, const wgpu::Buffer& buffer, wgpu::MapMode mode, size_t size) {
+    WGPUBufferMapAsyncStatus status = WGPUBufferMapAsyncStatus_Unknown;
+    buffer.MapAsync(
+        mode, 0, size,
+        [](WGPUBufferMapAsyncStatus s, void* userdata) { *static_cast<WGPUBufferMapAsyncStatus*>(userdata) = s; }, &status);
+
+    while (status == WGPUBufferMapAsyncStatus_Unknown) {
+      device.Tick();
+      std::this_thread::sleep_for(std::chrono::microseconds{50});
+    }
+
+    if (status != WGPUBufferMapAsyncStatus_Success) {
+      std::cerr << "ExternalSort: failed to map a staging buffer, with status: " << static_cast<int>(status) << std::endl;
+      exit(1);
+    }
+}
+
+// Buffers the merged records in blocks, full blocks are written by a background
+// task while the next one fills up.
+struct BlockWriter {
+    BlockWriter(int fd, size_t blockSize) : fd{fd}, blockSize{blockSize} {
+      blocks[0].resize(blockSize);
+      blocks[1].resize(blockSize);
+    }
+
+    template <typename T>
+    void Append(const T* data, size_t count) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+      size_t size = count * sizeof(T);
+      while (size > 0) {
+        size_t n = std::min(size, blockSize - fill);
+        std::memcpy(blocks[current].data() + fill, bytes, n);
+        fill += n;
+        bytes += n;
+        size -= n;
+        if (fill == blockSize) {
+          Flush();
+        }
+      }
+    }
+
+    void Flush() {
+      if (pending.valid()) {
+        pending.get();
+      }
+      pending = std::async(std::launch::async, WriteAll, fd, blocks[current].data(), fill, offset);
+      offset += fill;
+      fill = 0;
+      current ^= 1;
+    }
+
+    void Finish() {
+      Flush();
+      pending.get();
+    }
+
+    int fd;
+    size_t blockSize;
+    std::vector<uint8_t> blocks[2];
+    std::future<void> pending;
+    uint32_t current = 0;
+    size_t fill = 0;
+    size_t offset = 0;
+};
+
+void ExternalSort::Init(const wgpu::Device& device, uint32_t chunkSize) {
+    this->chunkSize = chunkSize;
+    uint64_t byteSize = uint64_t(chunkSize) * sizeof(Record);
+
+    recordsBuffer = utils::CreateBuffer(device, byteSize, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "ExternalSort::records");
+    // Every chunk is a single segment, there are no segment heads to bind.
+    segmentsBuffer = utils::CreateBuffer(device, sizeof(uint32_t), wgpu::BufferUsage::Storage, "ExternalSort::segments");
+    for (uint32_t i = 0; i < 2; i++) {
+      uploadBuffers[i] = utils::CreateBuffer(device, byteSize, wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc, "ExternalSort::upload");
+      readbackBuffers[i] = utils::CreateBuffer(device, byteSize, wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst, "ExternalSort::readback");
+    }
+
+    sorter.Init(device, recordsBuffer, chunkSize, segmentsBuffer, 1);
+}
+
+void ExternalSort::SortFile(const wgpu::Device& device, const std::string& inputPath, const std::string& outputPath) {
+    int inputFd = open(inputPath.c_str(), O_RDONLY);
+    if (inputFd < 0) {
+      std::cerr << "ExternalSort: cannot open " << inputPath << ": " << std::strerror(errno) << std::endl;
+      exit(1);
+    }
+
+    struct stat info;
+    fstat(inputFd, &info);
+    size_t size = info.st_size;
+    if (size % sizeof(Record) != 0) {
+      std::cerr << "ExternalSort: " << inputPath << " is not a file of " << sizeof(Record) << " byte records" << std::endl;
+      exit(1);
+    }
+
+    int outputFd = open(outputPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (outputFd < 0) {
+      std::cerr << "ExternalSort: cannot open " << outputPath << ": " << std::strerror(errno) << std::endl;
+      exit(1);
+    }
+
+    size_t count = size / sizeof(Record);
+    if (count == 0) {
+      close(inputFd);
+      close(outputFd);
+      return;
+    }
+
+    void* input = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, inputFd, 0);
+    if (input == MAP_FAILED) {
+      std::cerr << "ExternalSort: cannot map " << inputPath << ": " << std::strerror(errno) << std::endl;
+      exit(1);
+    }
+    madvise(input, size, MADV_SEQUENTIAL);
+
+    // A single chunk is its own result.
+    if (count <= chunkSize) {
+      WriteRuns(device, static_cast<const Record*>(input), count, outputFd);
+      munmap(input, size);
+      close(inputFd);
+      close(outputFd);
+      return;
+    }
+
+    std::string runsPath = outputPath + ".runs";
+    int runsFd = open(runsPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (runsFd < 0) {
+      std::cerr << "ExternalSort: cannot open " << runsPath << ": " << std::strerror(errno) << std::endl;
+      exit(1);
+    }
+
+    WriteRuns(device, static_cast<const Record*>(input), count, runsFd);
+    munmap(input, size);
+    close(inputFd);
+
+    void* runs = mmap(nullptr, size, PROT_READ, MAP_SHARED, runsFd, 0);
+    if (runs == MAP_FAILED) {
+      std::cerr << "ExternalSort: cannot map " << runsPath << ": " << std::strerror(errno) << std::endl;
+      exit(1);
+    }
+    madvise(runs, size, MADV_SEQUENTIAL);
+
+    MergeRuns(static_cast<const Record*>(runs), count, outputFd);
+
+    munmap(runs, size);
+    close(runsFd);
+    unlink(runsPath.c_str());
+    close(outputFd);
+}
+
+// Chunk i is copied into upload buffer i % 2 while the GPU still sorts chunk
+// i - 1, whose run is written out after chunk i has been submitted.
+void ExternalSort::WriteRuns(const wgpu::Device& device, const Record* records, size_t count, int fd) {
+    auto queue = device.GetQueue();
+    size_t numChunks = (count + chunkSize - 1) / chunkSize;
+    size_t chunkBytes = size_t(chunkSize) * sizeof(Record);
+
+    for (size_t i = 0; i <= numChunks; i++) {
+      if (i < numChunks) {
+        uint32_t slot = i % 2;
+        uint32_t chunkCount = static_cast<uint32_t>(std::min<size_t>(chunkSize, count - i * chunkSize));
+        size_t byteSize = size_t(chunkCount) * sizeof(Record);
+
+        MapAndWait(device, uploadBuffers[slot], wgpu::MapMode::Write, byteSize);
+        std::memcpy(uploadBuffers[slot].GetMappedRange(0, byteSize), records + i * chunkSize, byteSize);
+        uploadBuffers[slot].Unmap();
+
+        sorter.Upload(device, chunkCount, 0);
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        encoder.CopyBufferToBuffer(uploadBuffers[slot], 0, recordsBuffer, 0, byteSize);
+        sorter.Sort(encoder, wgpu::QuerySet(), chunkCount, 0);
+        encoder.CopyBufferToBuffer(recordsBuffer, 0, readbackBuffers[slot], 0, byteSize);
+        wgpu::CommandBuffer commandBuffer = encoder.Finish();
+        queue.Submit(1, &commandBuffer);
+      }
+
+      if (i > 0) {
+        size_t previous = i - 1;
+        uint32_t slot = previous % 2;
+        size_t byteSize = std::min(chunkBytes, (count - previous * chunkSize) * sizeof(Record));
+
+        MapAndWait(device, readbackBuffers[slot], wgpu::MapMode::Read, byteSize);
+        WriteAll(fd, readbackBuffers[slot].GetConstMappedRange(0, byteSize), byteSize, previous * chunkBytes);
+        readbackBuffers[slot].Unmap();
+      }
+    }
+}
+
+// K-way merge of the runs of chunkSize records by key, ties go to the earlier run.
+void ExternalSort::MergeRuns(const Record* runs, size_t count, int fd) {
+    BlockWriter writer(fd, 1u << 22u);
+    KWayMerge(runs, count, chunkSize, [](const Record& record) { return record.key; },
+              [&](const Record* first, size_t n) { writer.Append(first, n); });
+    writer.Finish();
+}
+
+void ExternalSort::Dispose() {
+    sorter.Dispose();
+    recordsBuffer.Destroy();
+    segmentsBuffer.Destroy();
+    for (uint32_t i = 0; i < 2; i++) {
+      uploadBuffers[i].Destroy();
+      readbackBuffers[i].Destroy();
+    }
+}
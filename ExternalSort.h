@@ -0,0 +1,42 @@
+#pragma once
+
+#include <utility>
+#include <string>
+#include <chrono>
+using namespace std::chrono;
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+#include "SegSort.h"
+
+// File to file sort of binary uint2 records by their x component, for inputs
+// larger than both host memory headroom and GPU memory. The input is mapped and
+// streamed through two upload staging buffers in fixed-size chunks, each chunk
+// is sorted by a SegmentedSort as a single segment and written back as a sorted
+// run while the GPU works on the next one. The runs are then merged into the
+// output file, which is written by a background thread. Uses POSIX file
+// mapping.
+class ExternalSort {
+public:
+    void Dispose();
+    void Init(const wgpu::Device& device, uint32_t chunkSize = 1u << 24u);
+
+    // Runs go to a temporary file next to outputPath, removed once merged.
+    void SortFile(const wgpu::Device& device, const std::string& inputPath, const std::string& outputPath);
+
+    uint32_t ChunkSize() const { return chunkSize; }
+private:
+    using Record = SegmentedSort<uint32_t, uint32_t>::Record;
+
+    // Sorts the chunks of records into runs of chunkSize records at fd.
+    void WriteRuns(const wgpu::Device& device, const Record* records, size_t count, int fd);
+    void MergeRuns(const Record* runs, size_t count, int fd);
+
+    uint32_t chunkSize;
+
+    SegmentedSort<uint32_t, uint32_t> sorter;
+    wgpu::Buffer recordsBuffer;
+    wgpu::Buffer segmentsBuffer;
+    wgpu::Buffer uploadBuffers[2];
+    wgpu::Buffer readbackBuffers[2];
+};
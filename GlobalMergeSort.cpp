@@ -0,0 +1,197 @@
+#include "GlobalMergeSort.h"
+
+#include "ComputeUtil.h"
+#include "ShaderComposer.h"
+
+struct MergeSortParam {
+  uint32_t count;
+  uint32_t nt;
+  uint32_t vt;
+  // Merge pass of the uniform slot, partition and merge bind it with a dynamic offset.
+  uint32_t merge_pass;
+  uint32_t num_partitions;
+};
+
+void GlobalMergeSort::Init(const wgpu::Device& device, const wgpu::Buffer& inputBuffer, uint32_t inputSize) {
+    maxCount = inputSize;
+    maxNumPasses = ComputeUtil::find_log2(ComputeUtil::div_up(maxCount, nv), true);
+
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    uniformStride = std::max<uint32_t>(sizeof(MergeSortParam), limits.limits.minUniformBufferOffsetAlignment);
+
+    scratchBuffer = utils::CreateBuffer(device, maxCount * sizeof(uint32_t), wgpu::BufferUsage::Storage, "GlobalMergeSort::scratch");
+    // Slot i holds the parameters of merge pass i, the block sort reads slot 0.
+    paramBuffer = utils::CreateBuffer(device, std::max(maxNumPasses, 1u) * uniformStride, wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst, "GlobalMergeSort::params");
+    partitionBuffer = utils::CreateBuffer(device, (ComputeUtil::div_up(maxCount, nv) + 1) * sizeof(uint32_t), wgpu::BufferUsage::Storage, "GlobalMergeSort::partitions");
+
+    InitBlock(device, inputBuffer);
+    InitPartition(device, inputBuffer);
+    InitMerge(device, inputBuffer);
+}
+
+void GlobalMergeSort::InitBlock(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
+  {
+    auto bgl = utils::MakeBindGroupLayout(
+    device, "MergeSortBlock0", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+    });
+
+    blockPipeline[0] = ComputeUtil::CreatePipeline(device, bgl,
+      ShaderComposer().Define("IN_PLACE", 1u).Compose(
+        #include "mergesort/block.wgsl"
+        , "mergesort/block"
+      ), "Sort::MergeSortBlock0"
+    );
+
+    blockBindGroups[0] = utils::MakeBindGroup(
+      device, bgl,
+          {
+            { 0, inputBuffer },
+            { 1, paramBuffer, 0, sizeof(MergeSortParam) },
+      });
+  }
+
+  {
+    auto bgl = utils::MakeBindGroupLayout(
+    device, "MergeSortBlock1", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+    });
+
+    blockPipeline[1] = ComputeUtil::CreatePipeline(device, bgl,
+      ShaderComposer().Define("IN_PLACE", 0u).Compose(
+        #include "mergesort/block.wgsl"
+        , "mergesort/block"
+      ), "Sort::MergeSortBlock1"
+    );
+
+    blockBindGroups[1] = utils::MakeBindGroup(
+      device, bgl,
+          {
+            { 0, inputBuffer },
+            { 1, scratchBuffer },
+            { 2, paramBuffer, 0, sizeof(MergeSortParam) },
+      });
+  }
+}
+
+void GlobalMergeSort::InitPartition(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
+  auto bgl = utils::MakeBindGroupLayout(
+    device, "MergeSortPartition", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform, true }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage }, 
+  });
+
+  partitionPipeline = ComputeUtil::CreatePipeline(device, bgl,
+     #include "mergesort/partition.wgsl"
+     , "Sort::MergeSortPartition"
+  );
+
+  partitionBindGroups[0] = utils::MakeBindGroup(
+    device, bgl,
+        {
+          { 0, inputBuffer },
+          { 1, paramBuffer, 0, sizeof(MergeSortParam) },
+          { 2, partitionBuffer },
+    });
+  
+  partitionBindGroups[1] = utils::MakeBindGroup(
+    device, bgl,
+        {
+          { 0, scratchBuffer },
+          { 1, paramBuffer, 0, sizeof(MergeSortParam) },
+          { 2, partitionBuffer },
+    });
+}
+
+void GlobalMergeSort::InitMerge(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
+  auto bgl = utils::MakeBindGroupLayout(
+    device, "MergeSortMerge", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform, true }, 
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
+  });
+
+  mergePipeline = ComputeUtil::CreatePipeline(device, bgl,
+    #include "mergesort/merge.wgsl"
+    , "Sort::MergeSortMerge"
+  );
+ 
+  mergeBindGroups[0] = utils::MakeBindGroup(
+    device, bgl,
+        {
+          { 0, inputBuffer },
+          { 1, scratchBuffer },
+          { 2, paramBuffer, 0, sizeof(MergeSortParam) },
+          { 3, partitionBuffer },
+    });
+
+  mergeBindGroups[1] = utils::MakeBindGroup(
+    device, bgl,
+        {
+          { 0, scratchBuffer },
+          { 1, inputBuffer },
+          { 2, paramBuffer, 0, sizeof(MergeSortParam) },
+          { 3, partitionBuffer },
+    });
+}
+
+void GlobalMergeSort::Upload(const wgpu::Device& device, uint32_t count) {
+    if (count > maxCount) {
+      std::cerr << "GlobalMergeSort: need to resize (" << count  << "," << maxCount << ")";
+      exit(1);
+    }
+
+    uint32_t numPartitions = ComputeUtil::div_up(count, nv) + 1;
+
+    std::vector<uint8_t> data(std::max(maxNumPasses, 1u) * uniformStride);
+    for (uint32_t pass = 0; pass < std::max(maxNumPasses, 1u); pass++) {
+      MergeSortParam* params = reinterpret_cast<MergeSortParam*>(data.data() + pass * uniformStride);
+      params->count = count;
+      params->nt = nt;
+      params->vt = vt;
+      params->merge_pass = pass;
+      params->num_partitions = numPartitions;
+    }
+    device.GetQueue().WriteBuffer(paramBuffer, 0, data.data(), data.size());
+}
+
+void GlobalMergeSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count) {
+    uint32_t numCtas = ComputeUtil::div_up(count, nv);
+    uint32_t numPasses = ComputeUtil::find_log2(numCtas, true);
+    uint32_t numPartitionDispatch = ComputeUtil::div_up(numCtas + 1, nv);
+
+    auto sortPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
+
+    // With an odd number of merge passes the block sort writes to the scratch
+    // buffer, so the last merge pass always ends in the input buffer.
+    uint32_t bindGroupIndex = numPasses & 1;
+    sortPass.SetPipeline(blockPipeline[bindGroupIndex]);
+    sortPass.SetBindGroup(0, blockBindGroups[bindGroupIndex]);
+    ComputeUtil::DispatchLinear(sortPass, numCtas);
+
+    for (uint32_t pass = 0; pass < numPasses; pass++) {
+      uint32_t offset = pass * uniformStride;
+      sortPass.SetPipeline(partitionPipeline);
+      sortPass.SetBindGroup(0, partitionBindGroups[bindGroupIndex % 2], 1, &offset);
+      sortPass.DispatchWorkgroups(numPartitionDispatch);
+
+      sortPass.SetPipeline(mergePipeline);
+      sortPass.SetBindGroup(0, mergeBindGroups[bindGroupIndex % 2], 1, &offset);
+      ComputeUtil::DispatchLinear(sortPass, numCtas);
+      bindGroupIndex++;
+    }
+
+    sortPass.End();
+}
+
+void GlobalMergeSort::Dispose() {
+    scratchBuffer.Destroy();
+    paramBuffer.Destroy();
+    partitionBuffer.Destroy();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <utility>
+#include <chrono>
+using namespace std::chrono;
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+
+// Device-wide merge sort of u32 keys without any segment bookkeeping. Tiles of
+// nv keys are block sorted, then merged pairwise with merge path passes whose
+// partitions are searched for by a separate kernel before every pass.
+class GlobalMergeSort {
+public:
+    void Dispose();
+    void Init(
+      const wgpu::Device& device,
+      const wgpu::Buffer& inputBuffer, 
+      uint32_t inputSize
+    );
+
+    void Upload(const wgpu::Device& device, uint32_t count);
+    void Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count);
+private:
+    const uint32_t nt = 128;
+    const uint32_t vt = 15;
+    const uint32_t nv = 1920;
+
+    uint32_t maxCount;
+    uint32_t maxNumPasses;
+    uint32_t uniformStride;
+
+    void InitBlock(const wgpu::Device& device, const wgpu::Buffer& inputBuffer);
+    void InitPartition(const wgpu::Device& device, const wgpu::Buffer& inputBuffer);
+    void InitMerge(const wgpu::Device& device, const wgpu::Buffer& inputBuffer);
+
+    wgpu::ComputePipeline blockPipeline[2];
+    wgpu::ComputePipeline partitionPipeline;
+    wgpu::ComputePipeline mergePipeline;
+    wgpu::BindGroup blockBindGroups[2];
+    wgpu::BindGroup partitionBindGroups[2];
+    wgpu::BindGroup mergeBindGroups[2];
+    wgpu::Buffer scratchBuffer;
+    wgpu::Buffer paramBuffer;
+    wgpu::Buffer partitionBuffer;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <queue>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+// K-way merge of the sorted runs of runLength elements in data, the last run may
+// be shorter. The run heads are kept in a min-heap of (key, run), so ties go to
+// the earlier run and the merge is stable. keyOf projects the key of an element,
+// sink(first, n) receives the merged output in stretches of n consecutive
+// elements of a run: everything that still precedes the next smallest head is
+// passed on at once.
+template <typename T, typename KeyOf, typename Sink>
+void KWayMerge(const T* data, size_t count, size_t runLength, KeyOf keyOf, Sink sink) {
+    using Key = std::decay_t<std::invoke_result_t<KeyOf, const T&>>;
+    using Head = std::pair<Key, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+    size_t numRuns = (count + runLength - 1) / runLength;
+    std::vector<size_t> positions(numRuns);
+    std::vector<size_t> ends(numRuns);
+    for (size_t run = 0; run < numRuns; run++) {
+      positions[run] = run * runLength;
+      ends[run] = std::min(count, positions[run] + runLength);
+      heads.push({ keyOf(data[positions[run]]), run });
+    }
+
+    while (!heads.empty()) {
+      size_t run = heads.top().second;
+      heads.pop();
+
+      size_t& position = positions[run];
+      size_t end = ends[run];
+      if (!heads.empty()) {
+        const Head& next = heads.top();
+        end = position + 1;
+        while (end < ends[run] && Head(keyOf(data[end]), run) < next) {
+          end++;
+        }
+      }
+
+      sink(data + position, end - position);
+      position = end;
+      if (position < ends[run]) {
+        heads.push({ keyOf(data[position]), run });
+      }
+    }
+}
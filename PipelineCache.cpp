@@ -0,0 +1,148 @@
+#include "PipelineCache.h"
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <unistd.h>
+
+// FNV-1a, only used to name directories and entry files.
+static uint64_t Hash(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string Hex(uint64_t value) {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+PipelineCache::PipelineCache(const std::string& directory, const wgpu::Adapter& adapter) {
+    wgpu::AdapterProperties properties;
+    adapter.GetProperties(&properties);
+
+    std::stringstream key;
+    key << properties.name << "|" << properties.driverDescription << "|" << properties.vendorID << "|"
+        << properties.deviceID << "|" << static_cast<uint32_t>(properties.backendType);
+    isolationKey = key.str();
+
+    this->directory = std::filesystem::path(directory) / ("v" + std::to_string(Version)) / Hex(Hash(isolationKey.data(), isolationKey.size()));
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+      std::cerr << "PipelineCache: failed to create " << this->directory << ": " << error.message() << std::endl;
+      exit(1);
+    }
+}
+
+void PipelineCache::Attach(wgpu::DeviceDescriptor& desc) {
+    cacheDesc.isolationKey = isolationKey.c_str();
+    cacheDesc.loadDataFunction = Load;
+    cacheDesc.storeDataFunction = Store;
+    cacheDesc.functionUserdata = this;
+    cacheDesc.nextInChain = desc.nextInChain;
+    desc.nextInChain = &cacheDesc;
+}
+
+void PipelineCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+      std::filesystem::remove(entry.path());
+    }
+    stats = PipelineCacheStats();
+}
+
+PipelineCacheStats PipelineCache::Stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+std::filesystem::path PipelineCache::EntryPath(const void* key, size_t keySize) const {
+    return directory / (Hex(Hash(key, keySize)) + ".bin");
+}
+
+// Dawn first asks for the size with a null value, then for the data. An entry is
+// the key size, the key and the value.
+size_t PipelineCache::Load(const void* key, size_t keySize, void* value, size_t valueSize, void* userdata) {
+    PipelineCache* cache = static_cast<PipelineCache*>(userdata);
+
+    std::ifstream file(cache->EntryPath(key, keySize), std::ios::binary | std::ios::ate);
+    uint64_t storedKeySize = 0;
+    std::vector<char> storedKey;
+    uint64_t size = 0;
+    if (file) {
+      uint64_t fileSize = file.tellg();
+      file.seekg(0);
+      file.read(reinterpret_cast<char*>(&storedKeySize), sizeof(storedKeySize));
+      if (file && storedKeySize == keySize && fileSize >= sizeof(uint64_t) + keySize) {
+        storedKey.resize(keySize);
+        file.read(storedKey.data(), keySize);
+        if (file && std::memcmp(storedKey.data(), key, keySize) == 0) {
+          size = fileSize - sizeof(uint64_t) - keySize;
+        }
+      }
+    }
+
+    if (value == nullptr) {
+      if (size == 0) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->stats.misses++;
+      }
+      return size;
+    }
+    if (size == 0 || valueSize < size || !file.read(static_cast<char*>(value), size)) {
+      return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->stats.hits++;
+    cache->stats.bytesLoaded += size;
+    return size;
+}
+
+// The entry goes to a temporary file named after the process and thread, then
+// is renamed into place. Loads never see a partial entry, and concurrent stores
+// of the same entry never write into one file.
+void PipelineCache::Store(const void* key, size_t keySize, const void* value, size_t valueSize, void* userdata) {
+    PipelineCache* cache = static_cast<PipelineCache*>(userdata);
+    std::filesystem::path path = cache->EntryPath(key, keySize);
+
+    std::stringstream suffix;
+    suffix << ".tmp" << getpid() << "." << std::this_thread::get_id();
+    std::filesystem::path temporary = path;
+    temporary += suffix.str();
+
+    {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      uint64_t storedKeySize = keySize;
+      file.write(reinterpret_cast<const char*>(&storedKeySize), sizeof(storedKeySize));
+      file.write(static_cast<const char*>(key), keySize);
+      file.write(static_cast<const char*>(value), valueSize);
+      if (!file) {
+        // A failed store only costs a compile on the next start.
+        std::cerr << "PipelineCache: failed to write " << temporary << std::endl;
+        file.close();
+        std::filesystem::remove(temporary);
+        return;
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->stats.stores++;
+    cache->stats.bytesStored += valueSize;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <filesystem>
+
+#include <webgpu/webgpu_cpp.h>
+
+struct PipelineCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t stores = 0;
+  uint64_t bytesLoaded = 0;
+  uint64_t bytesStored = 0;
+};
+
+// On-disk backing store for Dawn's blob cache, which holds the translated
+// shaders and backend pipeline binaries. Attached to a device descriptor it lets
+// a restarted process skip Tint and the driver compile for every pipeline it has
+// created before. Entries live in <directory>/v<version>/<adapter>/, where the
+// adapter part hashes the adapter name, driver and ids, and each entry file is
+// named by the hash of its Dawn cache key, which covers the shader source. The
+// full key is stored in the entry and compared on load, so hash collisions miss.
+class PipelineCache {
+public:
+    // Bump when the entry layout changes, old entries are then ignored.
+    static const uint32_t Version = 1;
+
+    PipelineCache(const std::string& directory, const wgpu::Adapter& adapter);
+
+    // Chains the cache into desc, which must not be used after the cache is
+    // destroyed. The cache has to outlive every device created from desc.
+    void Attach(wgpu::DeviceDescriptor& desc);
+
+    // Removes every entry of this adapter.
+    void Clear();
+
+    PipelineCacheStats Stats();
+    const std::filesystem::path& Directory() const { return directory; }
+
+private:
+    static size_t Load(const void* key, size_t keySize, void* value, size_t valueSize, void* userdata);
+    static void Store(const void* key, size_t keySize, const void* value, size_t valueSize, void* userdata);
+    std::filesystem::path EntryPath(const void* key, size_t keySize) const;
+
+    std::filesystem::path directory;
+    std::string isolationKey;
+    wgpu::DawnCacheDeviceDescriptor cacheDesc;
+
+    // Dawn may load and store from several threads when pipelines compile
+    // asynchronously.
+    std::mutex mutex;
+    PipelineCacheStats stats;
+};
@@ -0,0 +1,135 @@
+#include "PipelineLibrary.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "wgpu/WGPUHelpers.h"
+
+// Libraries by device handle. Every library references its device, so a handle
+// is never reused for another device while it is registered.
+static std::mutex registryMutex;
+static std::unordered_map<WGPUDevice, std::shared_ptr<PipelineLibrary>> registry;
+
+std::shared_ptr<PipelineLibrary> PipelineLibrary::Get(const wgpu::Device& device) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<PipelineLibrary>& library = registry[device.Get()];
+    if (!library) {
+      library = std::make_shared<PipelineLibrary>(device);
+    }
+    return library;
+}
+
+void PipelineLibrary::Release(const wgpu::Device& device) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    WGPUDevice handle = device.Get();
+    registry.erase(handle);
+}
+
+void PipelineLibrary::Request(
+  const wgpu::BindGroupLayout& bgl,
+  const std::string& shader,
+  const char* label,
+  wgpu::ComputePipeline* target,
+  const std::shared_ptr<std::atomic<uint32_t>>& pending,
+  std::vector<wgpu::Future>* futures,
+  const ComputeUtil::PipelineConstants& constants
+) {
+    (*pending)++;
+
+    // Exact values, so variants never collide through rounding.
+    std::stringstream key;
+    key << label << '\0' << shader;
+    for (const auto& [name, value] : constants) {
+      key << '\0' << name << '=' << std::hexfloat << value;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = entries.try_emplace(key.str());
+    Entry* entry = &it->second;
+    if (!inserted) {
+      stats.shared++;
+      if (entry->ready) {
+        *target = entry->pipeline;
+        (*pending)--;
+      } else {
+        entry->waiters.push_back({target, pending});
+        futures->push_back(entry->compile);
+      }
+      return;
+    }
+    stats.compiles++;
+    entry->waiters.push_back({target, pending});
+
+    wgpu::ShaderModule& shaderModule = modules[shader];
+    if (!shaderModule) {
+      shaderModule = utils::CreateShaderModule(device, shader.c_str(), label);
+    }
+
+    wgpu::PipelineLayout pl = utils::MakeBasicPipelineLayout(device, &bgl);
+    std::vector<wgpu::ConstantEntry> constantEntries = ComputeUtil::MakeConstantEntries(constants);
+    wgpu::ComputePipelineDescriptor csDesc;
+    csDesc.layout = pl;
+    csDesc.compute.module = shaderModule;
+    csDesc.compute.entryPoint = "main";
+    csDesc.label = label;
+    csDesc.compute.constantCount = constantEntries.size();
+    csDesc.compute.constants = constantEntries.empty() ? nullptr : constantEntries.data();
+
+    // WaitAnyOnly, so the callback never runs inside this call and the compile
+    // can be started under the lock, where later requests find its future.
+    Compile* compile = new Compile{shared_from_this(), entry, label};
+    wgpu::CreateComputePipelineAsyncCallbackInfo callbackInfo{
+      nullptr, wgpu::CallbackMode::WaitAnyOnly, OnCreated, compile};
+    entry->compile = device.CreateComputePipelineAsync(&csDesc, callbackInfo);
+    futures->push_back(entry->compile);
+}
+
+void PipelineLibrary::OnCreated(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, const char* message, void* userdata) {
+    Compile* compile = static_cast<Compile*>(userdata);
+    if (status != WGPUCreatePipelineAsyncStatus_Success) {
+      std::cerr << "Failed to create " << compile->label << ": " << message << std::endl;
+      exit(1);
+    }
+
+    std::vector<Waiter> waiters;
+    {
+      std::lock_guard<std::mutex> lock(compile->library->mutex);
+      compile->entry->pipeline = wgpu::ComputePipeline::Acquire(pipeline);
+      compile->entry->ready = true;
+      waiters.swap(compile->entry->waiters);
+    }
+
+    // The targets are written before their batches see the decrement.
+    for (Waiter& waiter : waiters) {
+      *waiter.target = compile->entry->pipeline;
+      (*waiter.pending)--;
+    }
+    delete compile;
+}
+
+wgpu::BindGroupLayout PipelineLibrary::Layout(
+  const char* label,
+  const std::vector<utils::BindingLayoutEntryInitializationHelper>& entries
+) {
+    std::stringstream key;
+    for (const wgpu::BindGroupLayoutEntry& entry : entries) {
+      key << entry.binding << ',' << static_cast<uint32_t>(entry.visibility) << ','
+          << static_cast<uint32_t>(entry.buffer.type) << ',' << entry.buffer.hasDynamicOffset << ',' << entry.buffer.minBindingSize << ','
+          << static_cast<uint32_t>(entry.sampler.type) << ','
+          << static_cast<uint32_t>(entry.texture.sampleType) << ',' << static_cast<uint32_t>(entry.texture.viewDimension) << ',' << entry.texture.multisampled << ','
+          << static_cast<uint32_t>(entry.storageTexture.access) << ',' << static_cast<uint32_t>(entry.storageTexture.format) << ','
+          << static_cast<uint32_t>(entry.storageTexture.viewDimension) << ';';
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    wgpu::BindGroupLayout& layout = layouts[key.str()];
+    if (!layout) {
+      layout = utils::MakeBindGroupLayout(device, label, entries);
+    }
+    return layout;
+}
+
+PipelineLibraryStats PipelineLibrary::Stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <webgpu/webgpu_cpp.h>
+#include "ComputeUtil.h"
+
+struct PipelineLibraryStats {
+  // Pipelines compiled, and requests served by an existing or pending one.
+  uint64_t compiles = 0;
+  uint64_t shared = 0;
+};
+
+// Device scoped registry of compute pipelines, keyed by kernel variant: the label,
+// the full WGSL source, which holds the format and comparator of the variant, and
+// the values of its overridable constants such as the tile geometry. Variants
+// that only differ in their constants share one shader module. Sorter instances
+// on one device that build the same variant share a single immutable pipeline
+// and only own their buffers and bind groups. A variant that is still compiling
+// is shared as well, its requests are all completed by the one compile.
+// ComputeUtil::PipelineBatch goes through the library, so every sorter that
+// builds its pipelines with a batch shares them.
+//
+// Bind group layouts are registered as well, keyed by their entries. Sorters
+// take theirs from Layout, so a shared pipeline is always created with the
+// very layout the bind groups of every instance are made from.
+class PipelineLibrary : public std::enable_shared_from_this<PipelineLibrary> {
+public:
+    // The library of device, created on first use.
+    static std::shared_ptr<PipelineLibrary> Get(const wgpu::Device& device);
+    // Drops the library of device. The library holds a reference to its device,
+    // so call this before destroying a device that is not used anymore.
+    static void Release(const wgpu::Device& device);
+
+    // Writes the pipeline of (label, shader, constants) to target and then
+    // decrements pending, right away when the variant exists and once compiled
+    // otherwise. A variant that is not ready yet adds the future of its compile
+    // to futures. The compile only completes in Instance::WaitAny on it.
+    void Request(
+      const wgpu::BindGroupLayout& bgl,
+      const std::string& shader,
+      const char* label,
+      wgpu::ComputePipeline* target,
+      const std::shared_ptr<std::atomic<uint32_t>>& pending,
+      std::vector<wgpu::Future>* futures,
+      const ComputeUtil::PipelineConstants& constants = {}
+    );
+
+    // The bind group layout with entries, created on first use. The label is
+    // the one of the first request.
+    wgpu::BindGroupLayout Layout(
+      const char* label,
+      const std::vector<utils::BindingLayoutEntryInitializationHelper>& entries
+    );
+
+    PipelineLibraryStats Stats();
+
+    explicit PipelineLibrary(const wgpu::Device& device) : device(device) {}
+
+private:
+    struct Waiter {
+      wgpu::ComputePipeline* target;
+      std::shared_ptr<std::atomic<uint32_t>> pending;
+    };
+
+    struct Entry {
+      wgpu::ComputePipeline pipeline;
+      wgpu::Future compile;
+      bool ready = false;
+      std::vector<Waiter> waiters;
+    };
+
+    struct Compile {
+      std::shared_ptr<PipelineLibrary> library;
+      Entry* entry;
+      std::string label;
+    };
+
+    static void OnCreated(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, const char* message, void* userdata);
+
+    wgpu::Device device;
+    std::mutex mutex;
+    // Node based, so entries stay in place while compiles refer to them.
+    std::unordered_map<std::string, Entry> entries;
+    // Shader modules by source.
+    std::unordered_map<std::string, wgpu::ShaderModule> modules;
+    // Bind group layouts by their serialized entries.
+    std::unordered_map<std::string, wgpu::BindGroupLayout> layouts;
+    PipelineLibraryStats stats;
+};
@@ -0,0 +1,160 @@
+#include "RadixSort.h"
+
+#include "ComputeUtil.h"
+
+struct RadixUniformData {
+  uint32_t count;
+  uint32_t shift;
+  uint32_t pass;
+  uint32_t numTiles;
+};
+
+// sg_hist, tile_mem, scan_mem, digit_shift and tile_index of onesweep.wgsl.
+static const uint32_t onesweepWorkgroupStorage = (8 * 256 + 256 * 8 + 512 + 256 + 1) * sizeof(uint32_t);
+
+void RadixSort::Init(const wgpu::Device& device, const wgpu::Buffer& inputBuffer, uint32_t inputSize) {
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    if (onesweepWorkgroupStorage > limits.limits.maxComputeWorkgroupStorageSize) {
+      std::cerr << "RadixSort: tiles need more workgroup storage than supported" << std::endl;
+      exit(1);
+    }
+
+    maxCount = inputSize;
+    maxNumTiles = ComputeUtil::div_up(maxCount, tileSize);
+    uniformStride = std::max<uint32_t>(sizeof(RadixUniformData), limits.limits.minUniformBufferOffsetAlignment);
+
+    // Slot i holds the parameters of pass i, the histogram pass uses slot 0.
+    uniformBuffer = utils::CreateBuffer(device, numPasses * uniformStride, wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst, "RadixSort::uniforms");
+    scratchBuffer = utils::CreateBuffer(device, maxCount * sizeof(uint32_t), wgpu::BufferUsage::Storage, "RadixSort::scratch");
+    histogramBuffer = utils::CreateBuffer(device, numPasses * radix * sizeof(uint32_t), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "RadixSort::histogram");
+    // Zero initialized on creation, the passes keep it consistent afterwards.
+    statusBuffer = utils::CreateBuffer(device, maxNumTiles * radix * sizeof(uint32_t), wgpu::BufferUsage::Storage, "RadixSort::status");
+    tileCounterBuffer = utils::CreateBuffer(device, numPasses * sizeof(uint32_t), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "RadixSort::tileCounters");
+
+    auto histogramBgl = utils::MakeBindGroupLayout(
+    device, "RadixHistogram", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+    });
+
+  histogramPipeline = ComputeUtil::CreatePipeline(device, histogramBgl,
+    #include "radix/histogram.wgsl"
+    , "Sort::RadixHistogram"
+  );
+
+  histogramBindGroup = utils::MakeBindGroup(
+    device, histogramBgl,
+        {
+          { 0, inputBuffer },
+          { 1, histogramBuffer },
+          { 2, uniformBuffer, 0, sizeof(RadixUniformData) }
+    });
+
+    auto scanBgl = utils::MakeBindGroupLayout(
+    device, "RadixScan", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+    });
+
+  scanPipeline = ComputeUtil::CreatePipeline(device, scanBgl,
+    #include "radix/scan.wgsl"
+    , "Sort::RadixScan"
+  );
+
+  scanBindGroup = utils::MakeBindGroup(
+    device, scanBgl,
+        {
+          { 0, histogramBuffer },
+    });
+
+    auto onesweepBgl = utils::MakeBindGroupLayout(
+    device, "RadixOnesweep", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform, true },
+    });
+
+  onesweepPipeline = ComputeUtil::CreatePipeline(device, onesweepBgl,
+    #include "radix/onesweep.wgsl"
+    , "Sort::RadixOnesweep"
+  );
+
+  onesweepBindGroups[0] = utils::MakeBindGroup(
+    device, onesweepBgl,
+        {
+          { 0, inputBuffer },
+          { 1, scratchBuffer },
+          { 2, histogramBuffer },
+          { 3, statusBuffer },
+          { 4, tileCounterBuffer },
+          { 5, uniformBuffer, 0, sizeof(RadixUniformData) }
+    });
+
+  onesweepBindGroups[1] = utils::MakeBindGroup(
+    device, onesweepBgl,
+        {
+          { 0, scratchBuffer },
+          { 1, inputBuffer },
+          { 2, histogramBuffer },
+          { 3, statusBuffer },
+          { 4, tileCounterBuffer },
+          { 5, uniformBuffer, 0, sizeof(RadixUniformData) }
+    });
+}
+
+void RadixSort::Upload(const wgpu::Device& device, uint32_t count) {
+    if (count > maxCount) {
+      std::cerr << "RadixSort: need to resize (" << count  << "," << maxCount << ")";
+      exit(1);
+    }
+
+    std::vector<uint8_t> data(numPasses * uniformStride);
+    for (uint32_t pass = 0; pass < numPasses; pass++) {
+      RadixUniformData* uniforms = reinterpret_cast<RadixUniformData*>(data.data() + pass * uniformStride);
+      uniforms->count = count;
+      uniforms->shift = 8 * pass;
+      uniforms->pass = pass;
+      uniforms->numTiles = ComputeUtil::div_up(count, tileSize);
+    }
+
+    device.GetQueue().WriteBuffer(uniformBuffer, 0, data.data(), data.size());
+}
+
+void RadixSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count) {
+    uint32_t numTiles = ComputeUtil::div_up(count, tileSize);
+
+    encoder.ClearBuffer(histogramBuffer, 0, numPasses * radix * sizeof(uint32_t));
+    encoder.ClearBuffer(tileCounterBuffer, 0, numPasses * sizeof(uint32_t));
+
+    auto sortPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
+
+    sortPass.SetPipeline(histogramPipeline);
+    sortPass.SetBindGroup(0, histogramBindGroup);
+    ComputeUtil::DispatchLinear(sortPass, ComputeUtil::div_up(count, histogramKeysPerWorkgroup));
+
+    sortPass.SetPipeline(scanPipeline);
+    sortPass.SetBindGroup(0, scanBindGroup);
+    sortPass.DispatchWorkgroups(1);
+
+    // An even number of passes, the keys end up back in the input buffer.
+    sortPass.SetPipeline(onesweepPipeline);
+    for (uint32_t pass = 0; pass < numPasses; pass++) {
+      uint32_t offset = pass * uniformStride;
+      sortPass.SetBindGroup(0, onesweepBindGroups[pass % 2], 1, &offset);
+      ComputeUtil::DispatchLinear(sortPass, numTiles);
+    }
+
+    sortPass.End();
+}
+
+void RadixSort::Dispose() {
+    uniformBuffer.Destroy();
+    scratchBuffer.Destroy();
+    histogramBuffer.Destroy();
+    statusBuffer.Destroy();
+    tileCounterBuffer.Destroy();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <utility>
+#include <chrono>
+using namespace std::chrono;
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+
+// Device-wide LSD radix sort of u32 keys, 8 bits per pass. A single histogram
+// pass counts the digits of all passes, every scatter pass then ranks tiles with
+// subgroup ballots and finds their output offsets with a decoupled look-back.
+// Like SubgroupSort the kernels assume 32-lane subgroups.
+class RadixSort {
+public:
+    void Dispose();
+    void Init(
+      const wgpu::Device& device,
+      const wgpu::Buffer& inputBuffer,
+      uint32_t inputSize
+    );
+
+    void Upload(const wgpu::Device& device, uint32_t count);
+    void Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count);
+private:
+    static constexpr uint32_t radix = 256;
+    static constexpr uint32_t numPasses = 4;
+    const uint32_t tileSize = 256 * 8;
+    const uint32_t histogramKeysPerWorkgroup = 256 * 16;
+
+    uint32_t maxCount;
+    uint32_t maxNumTiles;
+    uint32_t uniformStride;
+
+    wgpu::ComputePipeline histogramPipeline;
+    wgpu::ComputePipeline scanPipeline;
+    wgpu::ComputePipeline onesweepPipeline;
+    wgpu::BindGroup histogramBindGroup;
+    wgpu::BindGroup scanBindGroup;
+    wgpu::BindGroup onesweepBindGroups[2];
+    wgpu::Buffer uniformBuffer;
+    wgpu::Buffer scratchBuffer;
+    wgpu::Buffer histogramBuffer;
+    wgpu::Buffer statusBuffer;
+    wgpu::Buffer tileCounterBuffer;
+};
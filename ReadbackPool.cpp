@@ -0,0 +1,182 @@
+#include "ReadbackPool.h"
+
+#include <iostream>
+
+ReadbackPool::ReadbackPool(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device)
+    : instance{instance}, device{device} {
+    if (device.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization)) {
+      eventThread = std::thread(&ReadbackPool::Run, this);
+    }
+}
+
+ReadbackPool::~ReadbackPool() {
+    if (eventThread.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      ready.notify_one();
+      eventThread.join();
+    } else {
+      while (WaitNext()) {
+      }
+    }
+
+    for (wgpu::Buffer& buffer : buffers) {
+      buffer.Destroy();
+    }
+}
+
+MappedRange::MappedRange(MappedRange&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedRange& MappedRange::operator=(MappedRange&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      pool = other.pool;
+      staging = std::move(other.staging);
+      data = other.data;
+      byteSize = other.byteSize;
+      other.pool = nullptr;
+      other.data = nullptr;
+      other.byteSize = 0;
+    }
+    return *this;
+}
+
+MappedRange::~MappedRange() {
+    Reset();
+}
+
+void MappedRange::Reset() {
+    if (pool) {
+      staging.Unmap();
+      pool->Release(staging);
+      pool = nullptr;
+      data = nullptr;
+    }
+}
+
+void ReadbackPool::Read(const wgpu::Buffer& buffer, uint64_t byteSize, Callback callback, uint64_t offset) {
+    Request* request = new Request{.pool = this, .staging = Acquire(byteSize), .byteSize = byteSize, .callback = std::move(callback), .range = nullptr, .future = {}};
+    Submit(request, buffer, offset);
+}
+
+std::future<MappedRange> ReadbackPool::Map(const wgpu::Buffer& buffer, uint64_t byteSize, uint64_t offset) {
+    Request* request = new Request{.pool = this, .staging = Acquire(byteSize), .byteSize = byteSize, .callback = nullptr,
+                                   .range = std::make_shared<std::promise<MappedRange>>(), .future = {}};
+    std::future<MappedRange> result = request->range->get_future();
+    Submit(request, buffer, offset);
+    return Deferred(std::move(result));
+}
+
+void ReadbackPool::Submit(Request* request, const wgpu::Buffer& buffer, uint64_t offset) {
+    uint64_t byteSize = request->byteSize;
+
+    wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+    encoder.CopyBufferToBuffer(buffer, offset, request->staging, 0, byteSize);
+    wgpu::CommandBuffer commandBuffer = encoder.Finish();
+    device.GetQueue().Submit(1, &commandBuffer);
+
+    wgpu::BufferMapCallbackInfo callbackInfo = {nullptr, wgpu::CallbackMode::WaitAnyOnly, &ReadbackPool::OnMapped, request};
+    request->future = request->staging.MapAsync(wgpu::MapMode::Read, 0, byteSize, callbackInfo);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(request);
+    }
+    ready.notify_one();
+}
+
+void ReadbackPool::OnMapped(WGPUBufferMapAsyncStatus status, void* userdata) {
+    Request* request = static_cast<Request*>(userdata);
+
+    if (request->range) {
+      MappedRange range;
+      if (status == WGPUBufferMapAsyncStatus_Success) {
+        range.pool = request->pool;
+        range.staging = request->staging;
+        range.data = request->staging.GetConstMappedRange(0, request->byteSize);
+        range.byteSize = request->byteSize;
+      } else {
+        std::cerr << "Failed to map buffer, with status:" << static_cast<int>(status) << std::endl;
+        request->pool->Release(request->staging);
+      }
+      request->range->set_value(std::move(range));
+      delete request;
+      return;
+    }
+
+    if (status == WGPUBufferMapAsyncStatus_Success) {
+      request->callback(request->staging.GetConstMappedRange(0, request->byteSize), request->byteSize);
+      request->staging.Unmap();
+    } else {
+      std::cerr << "Failed to read back buffer, with status:" << static_cast<int>(status) << std::endl;
+      request->callback(nullptr, 0);
+    }
+
+    request->pool->Release(request->staging);
+    delete request;
+}
+
+wgpu::Buffer ReadbackPool::Acquire(uint64_t byteSize) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = freeBuffers.lower_bound(byteSize);
+      if (it != freeBuffers.end()) {
+        wgpu::Buffer buffer = it->second;
+        freeBuffers.erase(it);
+        return buffer;
+      }
+    }
+
+    // Power of two sizes so that reads of similar sizes share buffers.
+    uint64_t size = 256;
+    while (size < byteSize) {
+      size *= 2;
+    }
+    wgpu::Buffer buffer = utils::CreateBuffer(device, size, wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::MapRead, "ReadbackPool::staging");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+void ReadbackPool::Release(const wgpu::Buffer& staging) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.insert({staging.GetSize(), staging});
+}
+
+// Maps complete in submission order, so the requests are waited for one by one.
+void ReadbackPool::Run() {
+    while (true) {
+      Request* request;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+          return;
+        }
+        request = pending.front();
+        pending.pop_front();
+      }
+
+      instance->WaitAny(request->future, UINT64_MAX);
+    }
+}
+
+bool ReadbackPool::WaitNext() {
+    Request* request;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending.empty()) {
+        return false;
+      }
+      request = pending.front();
+      pending.pop_front();
+    }
+
+    instance->WaitAny(request->future, UINT64_MAX);
+    return true;
+}
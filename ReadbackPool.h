@@ -0,0 +1,137 @@
+#pragma once
+
+#include <map>
+#include <span>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+
+class ReadbackPool;
+
+// A mapped staging buffer holding a read back range. The data stays valid until
+// the handle is destroyed, which unmaps the buffer and returns it to its pool,
+// so it must not outlive the pool.
+class MappedRange {
+public:
+    MappedRange() = default;
+    MappedRange(MappedRange&& other) noexcept;
+    MappedRange& operator=(MappedRange&& other) noexcept;
+    MappedRange(const MappedRange&) = delete;
+    MappedRange& operator=(const MappedRange&) = delete;
+    ~MappedRange();
+
+    // False when the map failed.
+    explicit operator bool() const { return data != nullptr; }
+
+    template <typename T>
+    std::span<const T> As() const {
+        return {static_cast<const T*>(data), static_cast<size_t>(byteSize / sizeof(T))};
+    }
+
+private:
+    friend class ReadbackPool;
+    void Reset();
+
+    ReadbackPool* pool = nullptr;
+    wgpu::Buffer staging;
+    const void* data = nullptr;
+    uint64_t byteSize = 0;
+};
+
+// Asynchronous buffer readback through a pool of reused MapRead staging buffers.
+// Every read copies the source range into a staging buffer, maps it and hands
+// the mapped request to an event thread that blocks in Instance::WaitAny until
+// the map completes, so no thread spins on Device::Tick. The event thread runs
+// the callbacks and unmaps the staging buffers while other threads use the
+// device, so it is only started when the device has ImplicitDeviceSynchronization.
+// Without it the returned futures are deferred: get() waits for the pending maps
+// on the calling thread, which also runs the callbacks.
+class ReadbackPool {
+public:
+    // data is null when the map failed.
+    using Callback = std::function<void(const void* data, uint64_t byteSize)>;
+
+    ReadbackPool(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device);
+    // Waits for the outstanding reads and destroys the staging buffers.
+    ~ReadbackPool();
+
+    // Reads byteSize bytes of buffer at offset, buffer needs CopySrc usage. The
+    // callback runs on the event thread, or without one on the next thread that
+    // waits for a read of the pool, at the latest in the destructor.
+    void Read(const wgpu::Buffer& buffer, uint64_t byteSize, Callback callback, uint64_t offset = 0);
+
+    // Maps byteSize bytes of buffer at offset without copying them out of the
+    // staging buffer, which stays out of the pool while the range is alive.
+    // Reading only the range that is needed also saves the transfer. byteSize
+    // and offset must be multiples of 4.
+    std::future<MappedRange> Map(const wgpu::Buffer& buffer, uint64_t byteSize, uint64_t offset = 0);
+
+    // Like Read, the future receives an empty vector when the map failed.
+    template <typename T>
+    std::future<std::vector<T>> Read(const wgpu::Buffer& buffer, uint64_t byteSize, uint64_t offset = 0) {
+        auto promise = std::make_shared<std::promise<std::vector<T>>>();
+        std::future<std::vector<T>> result = promise->get_future();
+        Read(buffer, byteSize, [promise](const void* data, uint64_t size) {
+            const T* values = static_cast<const T*>(data);
+            promise->set_value(data ? std::vector<T>(values, values + size / sizeof(T)) : std::vector<T>());
+        }, offset);
+        return Deferred(std::move(result));
+    }
+
+private:
+    friend class MappedRange;
+
+    struct Request {
+        ReadbackPool* pool;
+        wgpu::Buffer staging;
+        uint64_t byteSize;
+        Callback callback;
+        // Set for Map, the staging buffer is handed over mapped instead.
+        std::shared_ptr<std::promise<MappedRange>> range;
+        wgpu::Future future;
+    };
+
+    // Copies the source range into the staging buffer of request and maps it.
+    void Submit(Request* request, const wgpu::Buffer& buffer, uint64_t offset);
+    static void OnMapped(WGPUBufferMapAsyncStatus status, void* userdata);
+    // Smallest free staging buffer of at least byteSize bytes, or a new one.
+    wgpu::Buffer Acquire(uint64_t byteSize);
+    void Release(const wgpu::Buffer& staging);
+    void Run();
+    // Waits for the oldest pending map on the calling thread, false if there is none.
+    bool WaitNext();
+
+    // Without the event thread, get() of the returned future completes the
+    // pending maps until result is ready.
+    template <typename T>
+    std::future<T> Deferred(std::future<T> result) {
+        if (eventThread.joinable()) {
+            return result;
+        }
+        return std::async(std::launch::deferred, [this, result = std::move(result)]() mutable {
+            while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready && WaitNext()) {
+            }
+            return result.get();
+        });
+    }
+
+    const std::unique_ptr<wgpu::Instance>& instance;
+    wgpu::Device device;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Request*> pending;
+    std::multimap<uint64_t, wgpu::Buffer> freeBuffers;
+    std::vector<wgpu::Buffer> buffers;
+    bool stopping = false;
+    std::thread eventThread;
+};
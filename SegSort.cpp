@@ -1,13 +1,30 @@
 #include <utility>
 #include <thread>
 #include <chrono>
+#include <sstream>
+#include <future>
 using namespace std::chrono;
 
 #include "SegSort.h"
 #include "ComputeUtil.h"
+#include "ShaderComposer.h"
+#include "TileProfile.h"
 
-void SegmentedSort::InitPartition(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
-  auto bgl = utils::MakeBindGroupLayout(
+// Layout of bucketCounterBuffer in words: the four bucket counts followed by the
+// indirect dispatch arguments written by seg_bucket_args.wgsl.
+const uint32_t BUCKET_ARGS_OFFSET = 4;
+const uint32_t BINARY_SEARCH_ARGS_OFFSET = 13;
+const uint32_t BLOCK_ARGS_OFFSET = 16;
+const uint32_t PARTITION_ARGS_OFFSET = 19;
+const uint32_t BUCKET_COUNTER_WORDS = 22;
+
+// Binding of the packed argsort keys in both block kernels, past their own bindings.
+const uint32_t ARGSORT_KEYS_BINDING = 8;
+
+SegmentedSortBase::SegmentedSortBase(const SortFormat& format) : format(format) {}
+
+void SegmentedSortBase::InitPartition(const wgpu::Device& device) {
+  partitionLayout = pipelines.Layout(
     device, "PartitionLayout", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
@@ -17,179 +34,162 @@ void SegmentedSort::InitPartition(const wgpu::Device& device, const wgpu::Buffer
         { 5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
         { 6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
         { 7, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 8, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
   });
 
-  partitionPipeline = ComputeUtil::CreatePipeline(device, bgl,
-    #include "segsort_tuple/seg_partition.wgsl"
-    , "Sort::partitionPipeline"
+  pipelines.Add(device, partitionLayout,
+    Composer().Compose(
+      #include "segsort_tuple/seg_partition.wgsl"
+      , "seg_partition"
+    ), "Sort::partitionPipeline", &partitionPipeline, TileConstants()
   );
-
-  partitionBindGroups[0] = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, inputBuffer },         
-          { 1, paramBuffer, 0, sizeof(Param) },
-          { 2, mergeRangesBuffer },
-          { 3, compressedRangesBuffer },
-          { 4, passCountBuffer },
-          { 5, opCounterBuffer },
-          { 6, mergeListBuffer },
-          { 7, copyListBuffer },
-    });
-  
-  partitionBindGroups[1] = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, inputBufferCopy },         
-          { 1, paramBuffer, 0, sizeof(Param) },
-          { 2, mergeRangesBuffer },
-          { 3, compressedRangesBuffer },
-          { 4, passCountBuffer },
-          { 5, opCounterBuffer },
-          { 6, mergeListBuffer },
-          { 7, copyListBuffer },
-    });
 }
 
-void SegmentedSort::InitClear(const wgpu::Device& device) {
-  auto bgl = utils::MakeBindGroupLayout(
+void SegmentedSortBase::InitClear(const wgpu::Device& device) {
+  clearLayout = pipelines.Layout(
     device, "ClearLayout", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
         { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage }, 
   });
 
-  clearPipeline = ComputeUtil::CreatePipeline(device, bgl,
+  pipelines.Add(device, clearLayout,
     #include "segsort_tuple/seg_clear.wgsl"
-    , "Sort::clearPipeline"
+    , "Sort::clearPipeline", &clearPipeline
   );
-
-  clearBindGroup = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, paramBuffer, 0, sizeof(Param) },
-          { 1, opCounterBuffer },
-          { 2, passCountBuffer },
-    });
 }
 
-void SegmentedSort::InitCopy(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
-  auto bgl = utils::MakeBindGroupLayout(
+void SegmentedSortBase::InitCopy(const wgpu::Device& device) {
+  copyLayout = pipelines.Layout(
     device, "CopyLayout", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
         { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
         { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
   });
 
-  copyPipeline = ComputeUtil::CreatePipeline(device, bgl,
-    #include "segsort_tuple/seg_copy.wgsl"
-    , "Sort::copyPipeline"
+  pipelines.Add(device, copyLayout,
+    Composer().Compose(
+      #include "segsort_tuple/seg_copy.wgsl"
+      , "seg_copy"
+    ), "Sort::copyPipeline", &copyPipeline, TileConstants()
   );
-
-  copyBindGroups[0] = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, inputBuffer },
-          { 1, inputBufferCopy },
-          { 2, copyListBuffer },
-          { 3, paramBuffer, 0, sizeof(Param) },
-    });
-  copyBindGroups[1] = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, inputBufferCopy },
-          { 1, inputBuffer },
-          { 2, copyListBuffer },
-          { 3, paramBuffer, 0, sizeof(Param) },
-    });
 } 
 
-void SegmentedSort::InitBlock(
-  const wgpu::Device& device, 
-  const wgpu::Buffer& inputBuffer, 
-  const wgpu::Buffer& segmentsBuffer
-) {
+void SegmentedSortBase::InitOpArgs(const wgpu::Device& device) {
+  opArgsLayout = pipelines.Layout(
+    device, "OpArgsLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+  });
+
+  pipelines.Add(device, opArgsLayout,
+    #include "segsort_tuple/seg_op_args.wgsl"
+    , "Sort::opArgsPipeline", &opArgsPipeline
+  );
+}
 
+void SegmentedSortBase::InitBlock(const wgpu::Device& device) {
   {
-    auto bgl0 = utils::MakeBindGroupLayout(
-    device, "BlockLayout0", {
+    std::vector<utils::BindingLayoutEntryInitializationHelper> layoutEntries = {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
-        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
         { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
-  });
+    };
+    if (format.argsort) {
+      layoutEntries.push_back({ ARGSORT_KEYS_BINDING, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage });
+    }
+    blockLayouts[0] = pipelines.Layout(device, "BlockLayout0", layoutEntries);
 
-  blockPipeline[0] = ComputeUtil::CreatePipeline(device, bgl0,
-    #include "segsort_tuple/seg_block_0.wgsl"
-    , "Sort::blockPipeline0"
+  pipelines.Add(device, blockLayouts[0],
+    Composer().Define("IN_PLACE", 1u).Prelude(BlockPrelude()).Compose(
+      #include "segsort_tuple/seg_block.wgsl"
+      , "seg_block"
+    ), "Sort::blockPipeline0", &blockPipeline[0], TileConstants()
   );
 
-  blockBindGroups[0] = utils::MakeBindGroup(
-    device, bgl0,
-        {
-          { 0, inputBuffer },
-          { 1, paramBuffer, 0, sizeof(Param) },
-          { 2, segmentsBuffer },
-          { 3, partitionBuffer },
-          { 4, compressedRangesBuffer },
-    });
+  // SortBucketed only needs the tiles that hold part of a long segment sorted.
+  if (!format.argsort) {
+    pipelines.Add(device, blockLayouts[0],
+      Composer().Define("IN_PLACE", 1u).Define("LONG_ONLY", 1u).Prelude(BlockPrelude()).Prelude(BucketPrelude()).Compose(
+        #include "segsort_tuple/seg_block.wgsl"
+        , "seg_block"
+      ), "Sort::blockLongPipeline0", &blockLongPipeline[0], TileConstants()
+    );
+  }
   }
 
   {
-    auto bgl = utils::MakeBindGroupLayout(
-    device, "BlockLayout1", {
+    std::vector<utils::BindingLayoutEntryInitializationHelper> layoutEntries = {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
-        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
         { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
-  });
+    };
+    if (format.argsort) {
+      layoutEntries.push_back({ ARGSORT_KEYS_BINDING, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage });
+    }
+    blockLayouts[1] = pipelines.Layout(device, "BlockLayout1", layoutEntries);
 
-  blockPipeline[1] = ComputeUtil::CreatePipeline(device, bgl,
-    #include "segsort_tuple/seg_block.wgsl"
-    , "Sort::blockPipeline1"
+  pipelines.Add(device, blockLayouts[1],
+    Composer().Define("IN_PLACE", 0u).Prelude(BlockPrelude()).Compose(
+      #include "segsort_tuple/seg_block.wgsl"
+      , "seg_block"
+    ), "Sort::blockPipeline1", &blockPipeline[1], TileConstants()
   );
 
-  blockBindGroups[1] = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, inputBuffer },
-          { 1, inputBufferCopy },
-          { 2, paramBuffer, 0, sizeof(Param) },
-          { 3, segmentsBuffer },
-          { 4, partitionBuffer },
-          { 5, compressedRangesBuffer },
-    });
+  if (!format.argsort) {
+    pipelines.Add(device, blockLayouts[1],
+      Composer().Define("IN_PLACE", 0u).Define("LONG_ONLY", 1u).Prelude(BlockPrelude()).Prelude(BucketPrelude()).Compose(
+        #include "segsort_tuple/seg_block.wgsl"
+        , "seg_block"
+      ), "Sort::blockLongPipeline1", &blockLongPipeline[1], TileConstants()
+    );
+  }
   }
 } 
 
-void SegmentedSort::InitBinarySearch(const wgpu::Device& device, const wgpu::Buffer& segmentsBuffer) {
-  auto bgl = utils::MakeBindGroupLayout(
+void SegmentedSortBase::InitBinarySearch(const wgpu::Device& device) {
+  binarySearchLayout = pipelines.Layout(
     device, "BinarySearchLayout", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
         { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
   });
 
-  binarySearchPipeline = ComputeUtil::CreatePipeline(device, bgl,
-    #include "segsort_tuple/binary_search.wgsl"
-    , "Sort::binarySearchPipeline"
+  pipelines.Add(device, binarySearchLayout,
+    Composer().Compose(
+      #include "segsort_tuple/binary_search.wgsl"
+      , "binary_search"
+    ), "Sort::binarySearchPipeline", &binarySearchPipeline, TileConstants()
   );
-
-  binarySearchBindGroup = utils::MakeBindGroup(
-    device, bgl,
-        {
-          { 0, segmentsBuffer },
-          { 1, partitionBuffer },
-          { 2, paramBuffer, 0, sizeof(Param) },
-    });
 } 
 
-void SegmentedSort::InitMerge(const wgpu::Device& device, const wgpu::Buffer& inputBuffer) {
-  auto bgl = utils::MakeBindGroupLayout(
+void SegmentedSortBase::InitRadix(const wgpu::Device& device) {
+  radixLayout = pipelines.Layout(
+    device, "RadixLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+  });
+
+  pipelines.Add(device, radixLayout,
+    format.ShaderPrelude() +
+    #include "segsort_tuple/seg_radix.wgsl"
+    , "Sort::radixPipeline", &radixPipeline
+  );
+}
+
+void SegmentedSortBase::InitMerge(const wgpu::Device& device) {
+  mergeLayout = pipelines.Layout(
     device, "MergeLayout", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
@@ -197,38 +197,376 @@ void SegmentedSort::InitMerge(const wgpu::Device& device, const wgpu::Buffer& in
         { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
         { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
         { 5, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
+        { 6, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage }, 
+  });
+
+  pipelines.Add(device, mergeLayout,
+    Composer().Compose(
+      #include "segsort_tuple/seg_merge.wgsl"
+      , "seg_merge"
+    ), "Sort::mergePipeline", &mergePipeline, TileConstants()
+  );
+} 
+
+// Composer of the tile kernels, which are generated for the format and the
+// values per thread of this sorter. The thread counts are set per pipeline, see
+// TileConstants.
+ShaderComposer SegmentedSortBase::Composer() const {
+  ShaderComposer composer;
+  composer.Define("VT", vt);
+  composer.Prelude(format.ShaderPrelude());
+  return composer;
+}
+
+// Overridable constants of the tile kernels, see segsort_tuple/lib/tile.wgsl.
+ComputeUtil::PipelineConstants SegmentedSortBase::TileConstants() const {
+  return { { "NT", nt }, { "NT2", nt2 } };
+}
+
+// load_elem(i) reads element i in the block kernels. Argsort formats build it from
+// the packed keys instead, with the index as the payload.
+std::string SegmentedSortBase::BlockPrelude() const {
+  std::stringstream ss;
+  if (!format.argsort) {
+    ss << "  fn load_elem(i: u32) -> Elem { return keys_src.data[i]; }\n";
+    return ss.str();
+  }
+
+  uint32_t keyWords = format.KeyWords();
+  ss << "  const INDEX_WORD = " << keyWords << "u;\n";
+  ss << "  @binding(" << ARGSORT_KEYS_BINDING << ") @group(0) var<storage, read> argsort_keys: array<u32>;\n";
+  ss << "  fn load_elem(i: u32) -> Elem {\n";
+  ss << "    var e = Elem();\n";
+  for (uint32_t word = 0; word < keyWords; word++) {
+    ss << "    e[" << word << "u] = argsort_keys[" << keyWords << "u * i + " << word << "u];\n";
+  }
+  ss << "    e[INDEX_WORD] = i;\n";
+  ss << "    return e;\n";
+  ss << "  }\n";
+  return ss.str();
+}
+
+std::string SegmentedSortBase::BucketPrelude() const {
+  std::stringstream ss;
+  ss << "  const BUCKET_LIMIT_0 = 32u;\n";
+  ss << "  const BUCKET_LIMIT_1 = 256u;\n";
+  ss << "  const BUCKET_LIMIT_2 = " << std::min(nv, bucketTileCapacity) << "u;\n";
+  return ss.str();
+}
+
+void SegmentedSortBase::InitBuckets(const wgpu::Device& device) {
+  bucketLayout = pipelines.Layout(
+    device, "BucketLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
   });
 
-  mergePipeline = ComputeUtil::CreatePipeline(device, bgl,
-    #include "segsort_tuple/seg_merge.wgsl"
-    , "Sort::mergePipeline"
+  pipelines.Add(device, bucketLayout,
+    BucketPrelude() +
+    #include "segsort_tuple/seg_bucket.wgsl"
+    , "Sort::bucketPipeline", &bucketPipeline
   );
- 
-  mergeBindGroups[0] = utils::MakeBindGroup(
-    device, bgl,
+
+  bucketArgsLayout = pipelines.Layout(
+    device, "BucketArgsLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+  });
+
+  pipelines.Add(device, bucketArgsLayout,
+    Composer().Compose(
+      #include "segsort_tuple/seg_bucket_args.wgsl"
+      , "seg_bucket_args"
+    ), "Sort::bucketArgsPipeline", &bucketArgsPipeline, TileConstants()
+  );
+
+  bucketSortLayout = pipelines.Layout(
+    device, "BucketSortLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 3, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 4, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+  });
+
+  pipelines.Add(device, bucketSortLayout,
+    format.ShaderPrelude() + BucketPrelude() +
+    #include "segsort_tuple/seg_bucket_thread.wgsl"
+    , "Sort::bucketSortPipeline0", &bucketSortPipelines[0]
+  );
+
+  pipelines.Add(device, bucketSortLayout,
+    format.ShaderPrelude() + BucketPrelude() +
+    "  const BUCKET = 1u;\n  const BUCKET_CAPACITY = 256u;\n" +
+    #include "segsort_tuple/seg_bucket_group.wgsl"
+    , "Sort::bucketSortPipeline1", &bucketSortPipelines[1]
+  );
+
+  pipelines.Add(device, bucketSortLayout,
+    format.ShaderPrelude() + BucketPrelude() +
+    "  const BUCKET = 2u;\n  const BUCKET_CAPACITY = " + std::to_string(bucketTileCapacity) + "u;\n" +
+    #include "segsort_tuple/seg_bucket_group.wgsl"
+    , "Sort::bucketSortPipeline2", &bucketSortPipelines[2]
+  );
+}
+
+void SegmentedSortBase::InitArgsortIndices(const wgpu::Device& device) {
+  indexLayout = pipelines.Layout(
+    device, "ArgsortIndicesLayout", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform }, 
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+  });
+
+  pipelines.Add(device, indexLayout,
+    format.ShaderPrelude() + "  const INDEX_WORD = " + std::to_string(format.KeyWords()) + "u;\n" +
+    #include "segsort_tuple/seg_argsort_indices.wgsl"
+    , "Sort::indexPipeline", &indexPipeline
+  );
+}
+
+// Bind groups of the kernels that only touch internal buffers, rebuilt whenever
+// the internal buffers are reallocated.
+void SegmentedSortBase::InitBindGroups(const wgpu::Device& device) {
+  clearBindGroup = utils::MakeBindGroup(
+    device, clearLayout,
         {
-          { 0, inputBuffer },
-          { 1, inputBufferCopy },
-          { 2, paramBuffer, 0, sizeof(Param) },
-          { 3, mergeListBuffer },
-          { 4, compressedRangesBuffer },
-          { 5, passCountBuffer },
+          { 0, paramBuffer, 0, sizeof(Param) },
+          { 1, opCounterBuffer },
+          { 2, passCountBuffer },
+    });
+
+  opArgsBindGroup = utils::MakeBindGroup(
+    device, opArgsLayout,
+        {
+          { 0, paramBuffer, 0, sizeof(Param) },
+          { 1, passCountBuffer },
+          { 2, opCounterBuffer },
+          { 3, opArgsBuffer },
+    });
 
+  bucketArgsBindGroup = utils::MakeBindGroup(
+    device, bucketArgsLayout,
+        {
+          { 0, paramBuffer, 0, sizeof(Param) },
+          { 1, bucketCounterBuffer },
     });
 
-  mergeBindGroups[1] = utils::MakeBindGroup(
-    device, bgl,
+  // The cached bind groups refer to the old internal buffers as well.
+  bindGroupCache.clear();
+}
+
+// input holds the keys of argsort formats, whose elements live in the sorter.
+SegmentedSortBase::BufferBindGroups SegmentedSortBase::MakeBufferBindGroups(const SortBufferRange& input, const SortBufferRange& segments) const {
+  BufferBindGroups groups;
+  const SortBufferRange elements = format.argsort ? SortBufferRange(inputBuffer) : input;
+  const SortBufferRange copy(inputBufferCopy);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    const SortBufferRange& src = i == 0 ? elements : copy;
+    const SortBufferRange& dst = i == 0 ? copy : elements;
+
+    groups.partition[i] = utils::MakeBindGroup(
+      device, partitionLayout,
+          {
+            { 0, src.buffer, src.offset, src.size },
+            { 1, paramBuffer, 0, sizeof(Param) },
+            { 2, mergeRangesBuffer },
+            { 3, compressedRangesBuffer },
+            { 4, passCountBuffer },
+            { 5, opCounterBuffer },
+            { 6, mergeListBuffer },
+            { 7, copyListBuffer },
+            { 8, copyStatusBuffer },
+      });
+
+    groups.merge[i] = utils::MakeBindGroup(
+      device, mergeLayout,
+          {
+            { 0, src.buffer, src.offset, src.size },
+            { 1, dst.buffer, dst.offset, dst.size },
+            { 2, paramBuffer, 0, sizeof(Param) },
+            { 3, mergeListBuffer },
+            { 4, compressedRangesBuffer },
+            { 5, passCountBuffer },
+            { 6, opArgsBuffer },
+      });
+
+    groups.copy[i] = utils::MakeBindGroup(
+      device, copyLayout,
+          {
+            { 0, src.buffer, src.offset, src.size },
+            { 1, dst.buffer, dst.offset, dst.size },
+            { 2, copyListBuffer },
+            { 3, paramBuffer, 0, sizeof(Param) },
+            { 4, opArgsBuffer },
+      });
+  }
+
+  {
+    std::vector<utils::BindingInitializationHelper> entries = {
+        { 0, elements.buffer, elements.offset, elements.size },
+        { 1, paramBuffer, 0, sizeof(Param) },
+        { 2, segments.buffer, segments.offset, segments.size },
+        { 3, partitionBuffer },
+        { 4, compressedRangesBuffer },
+    };
+    if (format.argsort) {
+      entries.push_back({ ARGSORT_KEYS_BINDING, input.buffer, input.offset, input.size });
+    }
+    groups.block[0] = utils::MakeBindGroup(device, blockLayouts[0], entries);
+  }
+
+  {
+    std::vector<utils::BindingInitializationHelper> entries = {
+        { 0, elements.buffer, elements.offset, elements.size },
+        { 1, inputBufferCopy },
+        { 2, paramBuffer, 0, sizeof(Param) },
+        { 3, segments.buffer, segments.offset, segments.size },
+        { 4, partitionBuffer },
+        { 5, compressedRangesBuffer },
+    };
+    if (format.argsort) {
+      entries.push_back({ ARGSORT_KEYS_BINDING, input.buffer, input.offset, input.size });
+    }
+    groups.block[1] = utils::MakeBindGroup(device, blockLayouts[1], entries);
+  }
+
+  groups.binarySearch = utils::MakeBindGroup(
+    device, binarySearchLayout,
         {
-          { 0, inputBufferCopy },
-          { 1, inputBuffer },
+          { 0, segments.buffer, segments.offset, segments.size },
+          { 1, partitionBuffer },
           { 2, paramBuffer, 0, sizeof(Param) },
-          { 3, mergeListBuffer },
-          { 4, compressedRangesBuffer },
-          { 5, passCountBuffer },
     });
-} 
 
-void SegmentedSort::Dispose() {
+  if (radixEnabled) {
+    groups.radixBinarySearch = utils::MakeBindGroup(
+      device, binarySearchLayout,
+          {
+            { 0, segments.buffer, segments.offset, segments.size },
+            { 1, radixPartitionBuffer },
+            { 2, radixParamBuffer, 0, sizeof(Param) },
+      });
+
+    groups.radix = utils::MakeBindGroup(
+      device, radixLayout,
+          {
+            { 0, elements.buffer, elements.offset, elements.size },
+            { 1, radixParamBuffer, 0, sizeof(Param) },
+            { 2, segments.buffer, segments.offset, segments.size },
+            { 3, radixPartitionBuffer },
+      });
+  }
+
+  groups.bucket = utils::MakeBindGroup(
+    device, bucketLayout,
+        {
+          { 0, segments.buffer, segments.offset, segments.size },
+          { 1, paramBuffer, 0, sizeof(Param) },
+          { 2, bucketCounterBuffer },
+          { 3, bucketListBuffer },
+    });
+
+  groups.bucketSort = utils::MakeBindGroup(
+    device, bucketSortLayout,
+        {
+          { 0, elements.buffer, elements.offset, elements.size },
+          { 1, paramBuffer, 0, sizeof(Param) },
+          { 2, segments.buffer, segments.offset, segments.size },
+          { 3, bucketListBuffer },
+          { 4, bucketCounterBuffer },
+    });
+
+  if (format.argsort) {
+    groups.index = utils::MakeBindGroup(
+      device, indexLayout,
+          {
+            { 0, elements.buffer, elements.offset, elements.size },
+            { 1, paramBuffer, 0, sizeof(Param) },
+            { 2, indexBuffer },
+      });
+  }
+  return groups;
+}
+
+const SegmentedSortBase::BufferBindGroups& SegmentedSortBase::BindBuffers(const SortBufferRange& input, const SortBufferRange& segments) {
+  auto same = [](const SortBufferRange& a, const SortBufferRange& b) {
+    return a.buffer.Get() == b.buffer.Get() && a.offset == b.offset && a.size == b.size;
+  };
+
+  for (auto it = bindGroupCache.begin(); it != bindGroupCache.end(); it++) {
+    if (same(it->input, input) && same(it->segments, segments)) {
+      bindGroupCache.splice(bindGroupCache.begin(), bindGroupCache, it);
+      return bindGroupCache.front().bindGroups;
+    }
+  }
+
+  // The entries hold references to their buffers, so a handle is never reused
+  // for another buffer while it is cached.
+  bindGroupCache.push_front({ input, segments, MakeBufferBindGroups(input, segments) });
+  while (bindGroupCache.size() > std::max(bindGroupCacheSize, 1u)) {
+    bindGroupCache.pop_back();
+  }
+  return bindGroupCache.front().bindGroups;
+}
+
+void SegmentedSortBase::SetBindGroupCacheSize(uint32_t size) {
+  bindGroupCacheSize = size;
+  while (bindGroupCache.size() > std::max(bindGroupCacheSize, 1u)) {
+    bindGroupCache.pop_back();
+  }
+}
+
+void SegmentedSortBase::SetTile(const SegmentedSortTile& tile) {
+  this->tile = tile;
+  tileSet = true;
+}
+
+static bool IsPow2(uint32_t x) {
+  return x > 1 && (x & (x - 1)) == 0;
+}
+
+bool SegmentedSortBase::TileFits(const SegmentedSortTile& tile, const SortFormat& format, const wgpu::Limits& limits) {
+  uint32_t maxThreads = std::min(limits.maxComputeInvocationsPerWorkgroup, limits.maxComputeWorkgroupSizeX);
+  if (!IsPow2(tile.nt) || !IsPow2(tile.nt2) || tile.nt > maxThreads || tile.nt2 > maxThreads) {
+    return false;
+  }
+  // One head flag bit per element of a thread, and tile offsets packed in 16 bits
+  // with nv itself as the empty marker.
+  if (tile.vt == 0 || tile.vt >= 32 || tile.nv() > 0xffff) {
+    return false;
+  }
+  // shared_ and ranges of seg_block.wgsl, the largest of the tile kernels.
+  uint64_t blockStorage = uint64_t(tile.nv() + 1) * format.ElementSize() + tile.nt * sizeof(int32_t);
+  uint64_t partitionStorage = 2 * tile.nt2 * sizeof(int32_t);
+  return std::max(blockStorage, partitionStorage) <= limits.maxComputeWorkgroupStorageSize;
+}
+
+SegmentedSortTile SegmentedSortBase::LargestTile(const SortFormat& format, const wgpu::Limits& limits) {
+  uint32_t maxThreads = std::min(limits.maxComputeInvocationsPerWorkgroup, limits.maxComputeWorkgroupSizeX);
+  SegmentedSortTile largest;
+  bool found = false;
+  // Ascending nt, so of two tiles with as many elements the one with more threads wins.
+  for (uint32_t nt = 32; nt <= maxThreads; nt *= 2) {
+    for (int vt = MaxTileVt | 1u; vt >= 1; vt -= 2) {
+      SegmentedSortTile tile{ nt, uint32_t(vt), std::min(SegmentedSortTile().nt2, maxThreads) };
+      if (!TileFits(tile, format, limits)) {
+        continue;
+      }
+      if (!found || tile.nv() >= largest.nv()) {
+        largest = tile;
+        found = true;
+      }
+      break;
+    }
+  }
+  return largest;
+}
+
+void SegmentedSortBase::DisposeBuffers() {
   inputBufferCopy.Destroy();
   partitionBuffer.Destroy();
   paramBuffer.Destroy();
@@ -237,18 +575,201 @@ void SegmentedSort::Dispose() {
   mergeRangesBuffer.Destroy();
   mergeListBuffer.Destroy();
   copyListBuffer.Destroy();
+  copyStatusBuffer.Destroy();
   opCounterBuffer.Destroy();
+  opArgsBuffer.Destroy();
+  bucketCounterBuffer.Destroy();
+  bucketListBuffer.Destroy();
+  if (radixEnabled) {
+    radixParamBuffer.Destroy();
+    radixPartitionBuffer.Destroy();
+  }
+  if (format.argsort) {
+    // The element buffer is the input buffer of argsort formats.
+    inputBuffer.Destroy();
+    indexBuffer.Destroy();
+  }
+}
+
+void SegmentedSortBase::Dispose() {
+  DisposeBuffers();
 }
 
-void SegmentedSort::Init(
+void SegmentedSortBase::InitArgsort(
+  const wgpu::Device& device,
+  const wgpu::Buffer& keysBuffer, 
+  uint32_t maxInputSize, 
+  const wgpu::Buffer& segmentBuffer, 
+  uint32_t maxSegmentSize
+) {
+    if (!format.argsort) {
+      std::cerr << "SegmentedSort: " << format.Name() << " is not an argsort format" << std::endl;
+      exit(1);
+    }
+
+    argsortKeysBuffer = keysBuffer;
+    Init(device, wgpu::Buffer(), maxInputSize, segmentBuffer, maxSegmentSize);
+}
+
+void SegmentedSortBase::Init(
+  const wgpu::Device& device,
+  const wgpu::Buffer& inputBuffer, 
+  uint32_t maxInputSize, 
+  const wgpu::Buffer& segmentBuffer, 
+  uint32_t maxSegmentSize
+) {
+    InitObjects(device, inputBuffer, maxInputSize, segmentBuffer, maxSegmentSize);
+    pipelines.Wait(device);
+}
+
+std::future<void> SegmentedSortBase::InitAsync(
   const wgpu::Device& device,
   const wgpu::Buffer& inputBuffer, 
   uint32_t maxInputSize, 
   const wgpu::Buffer& segmentBuffer, 
   uint32_t maxSegmentSize
 ) {
+    InitObjects(device, inputBuffer, maxInputSize, segmentBuffer, maxSegmentSize);
+    ComputeUtil::PipelineBatch batch = pipelines;
+    std::launch policy = device.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization) ? std::launch::async : std::launch::deferred;
+    return std::async(policy, [batch, device]() { batch.Wait(device); });
+}
+
+// Everything but the wait for the pipelines, which compile concurrently.
+void SegmentedSortBase::InitObjects(
+  const wgpu::Device& device,
+  const wgpu::Buffer& inputBuffer, 
+  uint32_t maxInputSize, 
+  const wgpu::Buffer& segmentBuffer, 
+  uint32_t maxSegmentSize
+) {
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+
+    // A stored tile that does not fit, e.g. after a driver update lowered the
+    // limits, is ignored rather than failing.
+    SegmentedSortTile profiled;
+    if (!tileSet) {
+      if (TileProfile::Lookup(device.GetAdapter(), format, &profiled) && TileFits(profiled, format, limits.limits)) {
+        tile = profiled;
+      } else {
+        tile = LargestTile(format, limits.limits);
+      }
+    }
+    if (!TileFits(tile, format, limits.limits)) {
+      std::cerr << "SegmentedSort: " << format.Name() << " tile " << tile.nt << "x" << tile.vt << " (nt2 " << tile.nt2 << ") does not fit the device limits" << std::endl;
+      exit(1);
+    }
+    nt = tile.nt;
+    vt = tile.vt;
+    nt2 = tile.nt2;
+    nv = tile.nv();
+
+    // elems, segs and leader_mem of seg_radix.wgsl plus the digit counters.
+    uint32_t radixStorage = radixCapacity * (format.ElementSize() + 2 * sizeof(uint32_t)) + (4 + 1 + 1) * 256 * sizeof(uint32_t);
+    // Custom comparators have no digit representation to radix sort on, argsort
+    // formats only get their payload in the block pass.
+    radixEnabled = format.HasRadixOrder() && !format.argsort && radixStorage <= limits.limits.maxComputeWorkgroupStorageSize;
+
+    // Smallest power of two tile that covers nv, halved until elems and positions
+    // of seg_bucket_group.wgsl fit. BUCKET_LIMIT_2 is the smaller of it and nv.
+    bucketTileCapacity = 256;
+    while (bucketTileCapacity < nv) {
+      bucketTileCapacity *= 2;
+    }
+    while (bucketTileCapacity > 256 && bucketTileCapacity * (format.ElementSize() + sizeof(uint32_t)) > limits.limits.maxComputeWorkgroupStorageSize) {
+      bucketTileCapacity /= 2;
+    }
+
+    // The initial sizes are also the floor for shrinking.
+    minCount = maxInputSize;
+    minNumSegments = maxSegmentSize;
+    this->device = device;
+    this->inputBuffer = inputBuffer;
+    segmentsBuffer = segmentBuffer;
+
+    InitBuffers(device, maxInputSize, maxSegmentSize);
+    InitBlock(device);
+    InitBinarySearch(device);
+    InitPartition(device);
+    InitMerge(device);
+    InitCopy(device);   
+    InitOpArgs(device);
+    InitClear(device);
+    if (radixEnabled) {
+      InitRadix(device);
+    }
+    InitBuckets(device);
+    if (format.argsort) {
+      InitArgsortIndices(device);
+    }
+    InitBindGroups(device);
+}
+
+void SegmentedSortBase::SetBuffers(const wgpu::Buffer& inputBuffer, const wgpu::Buffer& segmentBuffer) {
+    if (format.argsort) {
+      argsortKeysBuffer = inputBuffer;
+    } else {
+      this->inputBuffer = inputBuffer;
+    }
+    segmentsBuffer = segmentBuffer;
+}
+
+// base grown by factor, at least count and at most limit.
+static uint32_t GrownSize(uint32_t base, float factor, uint32_t count, uint64_t limit) {
+    double grown = std::min(double(base) * factor, double(std::min<uint64_t>(limit, UINT32_MAX)));
+    return std::max(count, static_cast<uint32_t>(grown));
+}
+
+bool SegmentedSortBase::Reserve(const wgpu::Device& device, uint32_t count, uint32_t segmentCount) {
+    if (count <= maxCount && segmentCount <= maxNumSegments) {
+      return true;
+    }
+
+    // The element buffers are bound whole and the bucket lists hold three words
+    // per segment, growth stops at what the device can bind.
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    uint64_t maxBytes = std::min<uint64_t>(limits.limits.maxStorageBufferBindingSize, limits.limits.maxBufferSize);
+    uint64_t countLimit = maxBytes / format.ElementSize();
+    uint64_t segmentLimit = maxBytes / (3 * sizeof(uint32_t)) - 1;
+    if (count > countLimit || segmentCount > segmentLimit) {
+      std::cerr << "SegmentedSort: " << count << " " << format.Name() << " elements in " << segmentCount << " segments exceed the storage buffer limits" << std::endl;
+      return false;
+    }
+
+    uint32_t newCount = GrownSize(maxCount, growth.factor, count, countLimit);
+    uint32_t newNumSegments = GrownSize(maxNumSegments, growth.factor, segmentCount, segmentLimit);
+    Reallocate(device, std::max(newCount, maxCount), std::max(newNumSegments, maxNumSegments));
+    return true;
+}
+
+void SegmentedSortBase::Reallocate(const wgpu::Device& device, uint32_t newCount, uint32_t newNumSegments) {
+    DisposeBuffers();
+    InitBuffers(device, newCount, newNumSegments);
+    InitBindGroups(device);
+
+    // The parameters live in the new param buffers and have to be written again.
+    previousCount = UINT32_MAX;
+    peakCount = 0;
+    peakNumSegments = 0;
+    idleUploads = 0;
+}
+
+void SegmentedSortBase::InitBuffers(const wgpu::Device& device, uint32_t maxInputSize, uint32_t maxSegmentSize) {
+    // Past the dispatch limits the element buffers are bound whole, so their
+    // binding size is what caps the element count.
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    uint64_t elementBytes = uint64_t(maxInputSize) * format.ElementSize();
+    if (elementBytes > limits.limits.maxStorageBufferBindingSize || elementBytes > limits.limits.maxBufferSize) {
+      std::cerr << "SegmentedSort: " << maxInputSize << " " << format.Name() << " elements exceed the storage buffer limits" << std::endl;
+      exit(1);
+    }
+
     maxCount = maxInputSize;
     maxNumCtas = ComputeUtil::div_up(maxCount, nv);
+    maxNumRadixWindows = ComputeUtil::div_up(maxCount, radixWindow);
     maxNumPasses = ComputeUtil::find_log2(maxNumCtas, true);
     maxNumSegments = maxSegmentSize; 
     maxCapacity = maxNumCtas;          
@@ -256,16 +777,6 @@ void SegmentedSort::Init(
       maxCapacity += ComputeUtil::div_up(maxNumCtas, 1 << i);
     }
 
-    InitBuffers(device);
-    InitBlock(device, inputBuffer, segmentBuffer);
-    InitBinarySearch(device, segmentBuffer);
-    InitPartition(device, inputBuffer);
-    InitMerge(device, inputBuffer);
-    InitCopy(device, inputBuffer);   
-    InitClear(device);
-}
-
-void SegmentedSort::InitBuffers(const wgpu::Device& device) {
     auto usage = wgpu::BufferUsage::Storage;
 
     compressedRangesBuffer = utils::CreateBuffer(
@@ -289,31 +800,58 @@ void SegmentedSort::InitBuffers(const wgpu::Device& device) {
       "SegSort::mergeList"
     );
 
-    if (maxNumCtas * sizeof(int) > COPY_STATUS_OFFSET*4) {
-      std::cerr << "Need bigger offset for copy status buffer" << std::endl;
-      exit(1);
-    }
     copyListBuffer = utils::CreateBuffer(
       device, 
-      maxNumCtas * sizeof(int) + COPY_STATUS_OFFSET*4 + maxNumCtas * sizeof(int),
+      maxNumCtas * sizeof(int),
       usage,
       "SegSort::copyList"
     );
 
+    copyStatusBuffer = utils::CreateBuffer(
+      device, 
+      maxNumCtas * sizeof(int),
+      usage,
+      "SegSort::copyStatus"
+    );
+
+    // Merge and copy count of every pass.
     opCounterBuffer = utils::CreateBuffer(
       device, 
-      np*sizeof(int) * 12, 
-      usage | wgpu::BufferUsage::Indirect,
+      np * sizeof(int) * 2, 
+      usage,
       "SegSort::opCounter"
     );
 
+    // Folded merge and copy dispatch arguments of the current pass, then their counts.
+    opArgsBuffer = utils::CreateBuffer(
+      device, 
+      8 * sizeof(uint32_t), 
+      usage | wgpu::BufferUsage::Indirect,
+      "SegSort::opArgs"
+    );
+
     inputBufferCopy = utils::CreateBuffer(
       device, 
-      maxCount * sizeof(int) * 2, 
+      uint64_t(maxCount) * format.ElementSize(), 
       wgpu::BufferUsage::Storage,
       "SegSort::inputBufferCopy"
     );
 
+    if (format.argsort) {
+      inputBuffer = utils::CreateBuffer(
+        device,
+        uint64_t(maxCount) * format.ElementSize(),
+        wgpu::BufferUsage::Storage,
+        "SegSort::argsortElements"
+      );
+      indexBuffer = utils::CreateBuffer(
+        device,
+        uint64_t(maxCount) * sizeof(uint32_t),
+        wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopySrc,
+        "SegSort::indices"
+      );
+    }
+
     paramBuffer = utils::CreateBuffer(
       device, 
       sizeof(Param), 
@@ -321,9 +859,10 @@ void SegmentedSort::InitBuffers(const wgpu::Device& device) {
       "SegSort::paramBuffer"
     );
 
+    // The binary search writes one entry per tile boundary.
     partitionBuffer = utils::CreateBuffer(
       device,
-      sizeof(int) * maxNumSegments,
+      sizeof(int) * std::max(maxNumSegments, maxNumCtas + 1),
       wgpu::BufferUsage::Storage,
       "SegSort::partitionBuffer"
     );
@@ -334,19 +873,68 @@ void SegmentedSort::InitBuffers(const wgpu::Device& device) {
       wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst,
       "SegSort::passCountBuffer"
     );
+
+    bucketCounterBuffer = utils::CreateBuffer(
+      device,
+      BUCKET_COUNTER_WORDS * sizeof(uint32_t),
+      wgpu::BufferUsage::Storage | wgpu::BufferUsage::Indirect | wgpu::BufferUsage::CopyDst,
+      "SegSort::bucketCounterBuffer"
+    );
+
+    // One list of segment indices per bucket, each long enough for every segment.
+    bucketListBuffer = utils::CreateBuffer(
+      device,
+      3 * (maxNumSegments + 1) * sizeof(uint32_t),
+      wgpu::BufferUsage::Storage,
+      "SegSort::bucketListBuffer"
+    );
+
+    if (radixEnabled) {
+      radixParamBuffer = utils::CreateBuffer(
+        device, 
+        sizeof(Param), 
+        wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst,
+        "SegSort::radixParamBuffer"
+      );
+
+      radixPartitionBuffer = utils::CreateBuffer(
+        device,
+        sizeof(int) * (maxNumRadixWindows + 1),
+        wgpu::BufferUsage::Storage,
+        "SegSort::radixPartitionBuffer"
+      );
+    }
 }
 
-void SegmentedSort::Clear(const wgpu::CommandEncoder& encoder) {
+void SegmentedSortBase::Clear(const wgpu::CommandEncoder& encoder) {
   // TODO: when fillBUffer -> fill opCounter with 1s and remove the clear pass 
   // encoder.ClearBuffer(passCountBuffer, 0, 4);
-  // encoder.ClearBuffer(opCounterBuffer, 0, maxNumPasses * 12 * sizeof(uint32_t));
+  // encoder.ClearBuffer(opCounterBuffer, 0, maxNumPasses * 2 * sizeof(uint32_t));
 }
 
-void SegmentedSort::Upload(const wgpu::Device& device, uint32_t count, uint32_t segmentCount) {
-   if (count > maxCount || segmentCount > maxNumSegments) {
-    std::cerr << "SegmentedSort: need to resize (" << count  << "," << maxCount << ")";
-    exit(1);
+bool SegmentedSortBase::Upload(const wgpu::Device& device, uint32_t count, uint32_t segmentCount) {
+  if (!Reserve(device, count, segmentCount)) {
+    return false;
   }
+
+  // Shrink back to a growth step above the largest request of the last
+  // shrinkAfterUploads uploads, never below the sizes given to Init.
+  if (growth.shrinkAfterUploads > 0) {
+    peakCount = std::max(peakCount, count);
+    peakNumSegments = std::max(peakNumSegments, segmentCount);
+    if (++idleUploads >= growth.shrinkAfterUploads) {
+      uint32_t newCount = GrownSize(peakCount, growth.factor, minCount, maxCount);
+      uint32_t newNumSegments = GrownSize(peakNumSegments, growth.factor, minNumSegments, maxNumSegments);
+      if (newCount * growth.factor < maxCount || newNumSegments * growth.factor < maxNumSegments) {
+        Reallocate(device, std::min(newCount, maxCount), std::min(newNumSegments, maxNumSegments));
+      } else {
+        peakCount = 0;
+        peakNumSegments = 0;
+        idleUploads = 0;
+      }
+    }
+  }
+
   uint32_t numCtas = ComputeUtil::div_up(count, nv);
   uint32_t numPasses = ComputeUtil::find_log2(numCtas, true);
 
@@ -354,7 +942,7 @@ void SegmentedSort::Upload(const wgpu::Device& device, uint32_t count, uint32_t
   int num_partitions = numCtas + 1;
   int num_partition_ctas = ComputeUtil::div_up(num_partitions, nt2 - 1);
 
-  if (count != previousCount) {
+  if (count != previousCount || segmentCount != params.num_segments) {
     params.nt = nt;
     params.vt = vt;
     params.count = count;
@@ -364,15 +952,150 @@ void SegmentedSort::Upload(const wgpu::Device& device, uint32_t count, uint32_t
     params.num_partition_ctas = num_partition_ctas;
     params.num_ranges = numCtas;
     params.max_num_passes = maxNumPasses;
+    params.partition_spacing = nv;
     device.GetQueue().WriteBuffer(paramBuffer, 0, &params, sizeof(Param));
+
+    if (radixEnabled) {
+      uint32_t numWindows = ComputeUtil::div_up(count, radixWindow);
+      radixParams = params;
+      radixParams.num_partitions = numWindows + 1;
+      radixParams.num_ranges = numWindows;
+      radixParams.partition_spacing = radixWindow;
+      device.GetQueue().WriteBuffer(radixParamBuffer, 0, &radixParams, sizeof(Param));
+    }
+  }
+  return true;
+}
+
+void SegmentedSortBase::SortSmallSegments(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, const BufferBindGroups& groups, uint32_t count) {
+  uint32_t numWindows = ComputeUtil::div_up(count, radixWindow);
+  uint32_t numBinarySearchDispatch = ComputeUtil::div_up(numWindows + 1, nv);
+
+  auto searchPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 1);
+  searchPass.SetPipeline(binarySearchPipeline);
+  searchPass.SetBindGroup(0, groups.radixBinarySearch);
+  ComputeUtil::DispatchLinear(searchPass, numBinarySearchDispatch);
+  searchPass.End();
+
+  auto radixPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 2);
+  radixPass.SetPipeline(radixPipeline);
+  radixPass.SetBindGroup(0, groups.radix);
+  ComputeUtil::DispatchLinear(radixPass, numWindows);
+  radixPass.End();
+}
+
+void SegmentedSortBase::Sort(
+  const wgpu::CommandEncoder& encoder, 
+  const wgpu::QuerySet& querySet, 
+  uint32_t count, 
+  uint32_t segmentCount, 
+  uint32_t maxSegmentLength
+) {
+  Sort(encoder, querySet, format.argsort ? argsortKeysBuffer : inputBuffer, segmentsBuffer, count, segmentCount, maxSegmentLength);
+}
+
+void SegmentedSortBase::Sort(
+  const wgpu::CommandEncoder& encoder, 
+  const wgpu::QuerySet& querySet, 
+  const SortBufferRange& input,
+  const SortBufferRange& segments,
+  uint32_t count, 
+  uint32_t segmentCount, 
+  uint32_t maxSegmentLength
+) {
+  if (!pipelines.Done()) {
+    std::cerr << "SegmentedSort: sorting before the future of InitAsync is ready" << std::endl;
+    exit(1);
+  }
+  if (count > maxCount || segmentCount > maxNumSegments) {
+    std::cerr << "SegmentedSort: " << count << " elements exceed the capacity " << maxCount << ", Upload first" << std::endl;
+    exit(1);
+  }
+
+  previousCount = count;
+  const BufferBindGroups& groups = BindBuffers(input, segments);
+  if (radixEnabled && maxSegmentLength <= MaxRadixSegmentLength()) {
+    SortSmallSegments(encoder, querySet, groups, count);
+    return;
+  }
+
+  EncodeMergePath(encoder, querySet, groups, count, false);
+  if (format.argsort) {
+    EncodeArgsortIndices(encoder, groups, count);
   }
 }
 
-void SegmentedSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count, uint32_t segmentCount) {
+void SegmentedSortBase::EncodeArgsortIndices(const wgpu::CommandEncoder& encoder, const BufferBindGroups& groups, uint32_t count) {
+  auto indexPass = encoder.BeginComputePass();
+  indexPass.SetPipeline(indexPipeline);
+  indexPass.SetBindGroup(0, groups.index);
+  ComputeUtil::DispatchLinear(indexPass, ComputeUtil::div_up(count, 128));
+  indexPass.End();
+}
+
+void SegmentedSortBase::SortBucketed(
+  const wgpu::CommandEncoder& encoder, 
+  const wgpu::QuerySet& querySet, 
+  uint32_t count, 
+  uint32_t segmentCount
+) {
+  SortBucketed(encoder, querySet, format.argsort ? argsortKeysBuffer : inputBuffer, segmentsBuffer, count, segmentCount);
+}
+
+void SegmentedSortBase::SortBucketed(
+  const wgpu::CommandEncoder& encoder, 
+  const wgpu::QuerySet& querySet, 
+  const SortBufferRange& input,
+  const SortBufferRange& segments,
+  uint32_t count, 
+  uint32_t segmentCount
+) {
+  if (!pipelines.Done()) {
+    std::cerr << "SegmentedSort: sorting before the future of InitAsync is ready" << std::endl;
+    exit(1);
+  }
   if (count > maxCount || segmentCount > maxNumSegments) {
-    std::cerr << "SegmentedSort: need to resize (" << count  << "," << maxCount << ")";
+    std::cerr << "SegmentedSort: " << count << " elements exceed the capacity " << maxCount << ", Upload first" << std::endl;
     exit(1);
   }
+
+  previousCount = count;
+  const BufferBindGroups& groups = BindBuffers(input, segments);
+  // The bucket kernels read whole elements, the argsort payload only exists once
+  // the block pass has run.
+  if (format.argsort) {
+    EncodeMergePath(encoder, querySet, groups, count, false);
+    EncodeArgsortIndices(encoder, groups, count);
+    return;
+  }
+
+  encoder.ClearBuffer(bucketCounterBuffer, 0, BUCKET_ARGS_OFFSET * sizeof(uint32_t));
+
+  // The op counters are cleared here as well, the gated merge path skips its clear pass.
+  auto bucketPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
+  bucketPass.SetPipeline(clearPipeline);
+  bucketPass.SetBindGroup(0, clearBindGroup);
+  bucketPass.DispatchWorkgroups(ComputeUtil::div_up(2 * maxNumPasses + 1, 128));
+
+  bucketPass.SetPipeline(bucketPipeline);
+  bucketPass.SetBindGroup(0, groups.bucket);
+  ComputeUtil::DispatchLinear(bucketPass, ComputeUtil::div_up(segmentCount + 1, 128));
+
+  bucketPass.SetPipeline(bucketArgsPipeline);
+  bucketPass.SetBindGroup(0, bucketArgsBindGroup);
+  bucketPass.DispatchWorkgroups(1);
+
+  for (uint32_t bucket = 0; bucket < 3; bucket++) {
+    bucketPass.SetPipeline(bucketSortPipelines[bucket]);
+    bucketPass.SetBindGroup(0, groups.bucketSort);
+    bucketPass.DispatchWorkgroupsIndirect(bucketCounterBuffer, (BUCKET_ARGS_OFFSET + 3 * bucket) * sizeof(uint32_t));
+  }
+  bucketPass.End();
+
+  EncodeMergePath(encoder, querySet, groups, count, true);
+}
+
+void SegmentedSortBase::EncodeMergePath(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, const BufferBindGroups& groups, uint32_t count, bool gated) {
   uint32_t numCtas = ComputeUtil::div_up(count, nv);
   uint32_t numPasses = ComputeUtil::find_log2(numCtas, true);
 
@@ -381,27 +1104,34 @@ void SegmentedSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QueryS
   int num_partition_ctas = ComputeUtil::div_up(num_partitions, nt2 - 1);
   uint32_t numBinarySearchDispatch = ComputeUtil::div_up(num_partitions, nv);
 
-
-  auto clearPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
-  clearPass.SetPipeline(clearPipeline);
-  clearPass.SetBindGroup(0, clearBindGroup);
-  clearPass.DispatchWorkgroups(ComputeUtil::div_up(maxNumPasses * 24, nv));
-  clearPass.End();
+  if (!gated) {
+    auto clearPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
+    clearPass.SetPipeline(clearPipeline);
+    clearPass.SetBindGroup(0, clearBindGroup);
+    clearPass.DispatchWorkgroups(ComputeUtil::div_up(2 * maxNumPasses + 1, 128));
+    clearPass.End();
+  }
   
   auto searchPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 1);
   searchPass.SetPipeline(binarySearchPipeline);
-  searchPass.SetBindGroup(0, binarySearchBindGroup);
-  searchPass.DispatchWorkgroups(numBinarySearchDispatch);
+  searchPass.SetBindGroup(0, groups.binarySearch);
+  if (gated) {
+    searchPass.DispatchWorkgroupsIndirect(bucketCounterBuffer, BINARY_SEARCH_ARGS_OFFSET * sizeof(uint32_t));
+  } else {
+    ComputeUtil::DispatchLinear(searchPass, numBinarySearchDispatch);
+  }
   searchPass.End();
 
   auto blockPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 2);
-  blockPass.SetPipeline(blockPipeline[blockBindgroupIndex]);
-  blockPass.SetBindGroup(0, blockBindGroups[blockBindgroupIndex]);
-  blockPass.DispatchWorkgroups(numCtas);
+  blockPass.SetPipeline(gated ? blockLongPipeline[blockBindgroupIndex] : blockPipeline[blockBindgroupIndex]);
+  blockPass.SetBindGroup(0, groups.block[blockBindgroupIndex]);
+  if (gated) {
+    blockPass.DispatchWorkgroupsIndirect(bucketCounterBuffer, BLOCK_ARGS_OFFSET * sizeof(uint32_t));
+  } else {
+    ComputeUtil::DispatchLinear(blockPass, numCtas);
+  }
   blockPass.End();
 
-
-  previousCount = count;
   if (numPasses == 0) {
     return;
   }
@@ -415,16 +1145,25 @@ void SegmentedSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QueryS
   auto mergePass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 3);
   for (int pass = 0; pass < numPasses; pass++) {
     mergePass.SetPipeline(partitionPipeline);
-    mergePass.SetBindGroup(0, partitionBindGroups[mergeBindgroupIndex % 2]);
-    mergePass.DispatchWorkgroups(num_partition_ctas);
+    mergePass.SetBindGroup(0, groups.partition[mergeBindgroupIndex % 2]);
+    if (gated) {
+      mergePass.DispatchWorkgroupsIndirect(bucketCounterBuffer, PARTITION_ARGS_OFFSET * sizeof(uint32_t));
+    } else {
+      ComputeUtil::DispatchLinear(mergePass, num_partition_ctas);
+    }
+
+    // The merge and copy counts are only known on the GPU, fold them into 2D grids.
+    mergePass.SetPipeline(opArgsPipeline);
+    mergePass.SetBindGroup(0, opArgsBindGroup);
+    mergePass.DispatchWorkgroups(1);
     
     mergePass.SetPipeline(mergePipeline);
-    mergePass.SetBindGroup(0, mergeBindGroups[mergeBindgroupIndex % 2]);
-    mergePass.DispatchWorkgroupsIndirect(opCounterBuffer, (pass * 6) * sizeof(int));
+    mergePass.SetBindGroup(0, groups.merge[mergeBindgroupIndex % 2]);
+    mergePass.DispatchWorkgroupsIndirect(opArgsBuffer, 0);
 
     mergePass.SetPipeline(copyPipeline);
-    mergePass.SetBindGroup(0, copyBindGroups[mergeBindgroupIndex % 2]);
-    mergePass.DispatchWorkgroupsIndirect(opCounterBuffer, ((pass*2+1) * 3) * sizeof(int));
+    mergePass.SetBindGroup(0, groups.copy[mergeBindgroupIndex % 2]);
+    mergePass.DispatchWorkgroupsIndirect(opArgsBuffer, 3 * sizeof(uint32_t));
     mergeBindgroupIndex++;
   }
   mergePass.End();
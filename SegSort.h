@@ -1,13 +1,17 @@
 #pragma once
 
+#include <list>
+#include <future>
 #include <utility>
+#include <string>
 #include <chrono>
 using namespace std::chrono;
 
 #include <webgpu/webgpu_cpp.h>
 #include "wgpu/WGPUHelpers.h"
-
-const int COPY_STATUS_OFFSET = 8192;
+#include "SortTypes.h"
+#include "ComputeUtil.h"
+#include "ShaderComposer.h"
 
 struct Param {
   uint32_t count;
@@ -19,10 +23,49 @@ struct Param {
   uint32_t num_ranges;
   uint32_t num_partition_ctas;
   uint32_t max_num_passes;
+  // Distance between the partition points searched for by binary_search.wgsl.
+  uint32_t partition_spacing;
+};
+
+// Capacity policy of the internal buffers of a SegmentedSort. Upload grows them
+// by factor whenever a request does not fit.
+struct SegmentedSortGrowth {
+  float factor = 1.5f;
+  // Number of uploads after which the buffers shrink back to one growth step
+  // above the largest request among them, 0 never shrinks.
+  uint32_t shrinkAfterUploads = 0;
+};
+
+// Tile geometry of a SegmentedSort: the block kernels sort tiles of nt * vt
+// elements with nt threads of vt elements each, nt2 threads of the partition
+// kernel search the merge paths of nt2 - 1 tiles.
+struct SegmentedSortTile {
+  uint32_t nt = 128;
+  uint32_t vt = 15;
+  uint32_t nt2 = 64;
+
+  uint32_t nv() const { return nt * vt; }
 };
 
-class SegmentedSort {
+// A range of a caller buffer bound for a sort. Offsets must be multiples of
+// minStorageBufferOffsetAlignment.
+struct SortBufferRange {
+  SortBufferRange() = default;
+  SortBufferRange(const wgpu::Buffer& buffer, uint64_t offset = 0, uint64_t size = wgpu::kWholeSize)
+      : buffer(buffer), offset(offset), size(size) {}
+
+  wgpu::Buffer buffer;
+  uint64_t offset = 0;
+  uint64_t size = wgpu::kWholeSize;
+};
+
+// Segmented merge sort over records described by a SortFormat. The kernels are
+// compiled for the format given at construction, see SegmentedSort<Key, Value>
+// for the typed front-end.
+class SegmentedSortBase {
 public:
+    explicit SegmentedSortBase(const SortFormat& format);
+
     void Dispose();
     void Init(
       const wgpu::Device& device,
@@ -32,52 +75,228 @@ public:
       uint32_t maxSegmentSize
     );
 
+    // Init that returns once the buffers and layouts exist, while the pipelines
+    // still compile. The future is ready when they are, sorting before that is an
+    // error. The sorter must outlive the future. The compiles are waited for on
+    // another thread only when the device has ImplicitDeviceSynchronization,
+    // otherwise the future is deferred and its get() waits on the calling thread.
+    std::future<void> InitAsync(
+      const wgpu::Device& device,
+      const wgpu::Buffer& inputBuffer, 
+      uint32_t maxInputSize, 
+      const wgpu::Buffer& segmentBuffer, 
+      uint32_t maxSegmentSize
+    );
+
     void Clear(const wgpu::CommandEncoder& encoder);
 
-    void Upload(
+    // Grows or shrinks the internal buffers as needed, see SegmentedSortGrowth. The
+    // bind groups of commands encoded before a resize refer to the old buffers, so
+    // encode the sort after uploading. Growth stops at the storage buffer limits of
+    // the device; returns false and keeps the buffers when count elements or
+    // segmentCount segments do not fit them at all.
+    bool Upload(
         const wgpu::Device& device, 
         uint32_t count, 
         uint32_t segmentCount);
 
-    void Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count, uint32_t segmentCount);
+    // Swaps in caller buffers, e.g. after the caller grew them. For argsort
+    // formats inputBuffer is the key buffer.
+    void SetBuffers(const wgpu::Buffer& inputBuffer, const wgpu::Buffer& segmentBuffer);
+
+    // Number of caller buffer ranges whose bind groups are kept, see the Sort
+    // overload taking buffers. The least recently sorted range is evicted first.
+    void SetBindGroupCacheSize(uint32_t size);
+
+    void SetGrowthPolicy(const SegmentedSortGrowth& policy) { growth = policy; }
+
+    // Tile used from the next Init on. Without one, Init takes the tile stored for
+    // the adapter and format in the tile profile, see TileProfile, and else the
+    // LargestTile of the device limits.
+    void SetTile(const SegmentedSortTile& tile);
+    const SegmentedSortTile& Tile() const { return tile; }
+
+    // Whether the kernels can be built for tile, format and limits: nt and nt2
+    // are powers of two within the workgroup limits, the head flags of a thread
+    // fit a word, tile offsets fit the 16 bits they are packed in and the tile
+    // fits workgroup storage.
+    static bool TileFits(const SegmentedSortTile& tile, const SortFormat& format, const wgpu::Limits& limits);
+
+    // Tile with the most elements that fits format and limits, so adapters with
+    // more workgroup storage need fewer global merge passes. vt is odd, which
+    // keeps the thread order accesses to shared memory free of bank conflicts, and
+    // at most MaxTileVt so the keys of a thread stay in registers. The default
+    // tile when none fits.
+    static SegmentedSortTile LargestTile(const SortFormat& format, const wgpu::Limits& limits);
+    static const uint32_t MaxTileVt = 23;
+
+    uint32_t Capacity() const { return maxCount; }
+    uint32_t SegmentCapacity() const { return maxNumSegments; }
+
+    // maxSegmentLength is an optional upper bound on the segment lengths. When
+    // every segment fits in a radix tile (see MaxRadixSegmentLength) the segments
+    // are radix sorted in shared memory and the block sort and merge passes are
+    // skipped entirely.
+    void Sort(
+        const wgpu::CommandEncoder& encoder, 
+        const wgpu::QuerySet& querySet, 
+        uint32_t count, 
+        uint32_t segmentCount, 
+        uint32_t maxSegmentLength = UINT32_MAX);
+
+    // Sorts count records of input with the segment heads in segments instead of
+    // the buffers given to Init or SetBuffers, so one sorter serves many buffers.
+    // The bind groups of a range are built on first use and cached, see
+    // SetBindGroupCacheSize. For argsort formats input holds the keys. The sorts
+    // of one submission share the parameters written by the last Upload, so they
+    // must sort the same counts.
+    void Sort(
+        const wgpu::CommandEncoder& encoder, 
+        const wgpu::QuerySet& querySet, 
+        const SortBufferRange& input,
+        const SortBufferRange& segments,
+        uint32_t count, 
+        uint32_t segmentCount, 
+        uint32_t maxSegmentLength = UINT32_MAX);
+
+    // Sorts without a bound on the segment lengths. A pre-pass buckets the
+    // segments by length on the GPU: up to 32 elements are sorted by a single
+    // thread, up to 256 and up to BucketTileCapacity() by one workgroup per
+    // segment. The workgroup sort is a bitonic sort in shared memory, not a
+    // subgroup sort, which WGSL cannot size to 256 elements portably; it breaks
+    // ties on the input position, so the result is stable like Sort(). The
+    // block sort and merge passes only get workgroups when some segment is
+    // longer than that, and only sort the tiles such a segment overlaps.
+    void SortBucketed(
+        const wgpu::CommandEncoder& encoder, 
+        const wgpu::QuerySet& querySet, 
+        uint32_t count, 
+        uint32_t segmentCount);
+
+    void SortBucketed(
+        const wgpu::CommandEncoder& encoder, 
+        const wgpu::QuerySet& querySet, 
+        const SortBufferRange& input,
+        const SortBufferRange& segments,
+        uint32_t count, 
+        uint32_t segmentCount);
+
+    const SortFormat& Format() const { return format; }
+
+    uint32_t BucketTileCapacity() const { return bucketTileCapacity; }
+
+    // Sorted element indices of an argsort format, see SegmentedArgsort. Upload
+    // may reallocate it.
+    const wgpu::Buffer& IndexBuffer() const { return indexBuffer; }
+
+    // Longest segment the segmented radix path can sort, 0 when the adapter does
+    // not have enough workgroup storage for it, the format has a custom comparator
+    // or is an argsort format.
+    uint32_t MaxRadixSegmentLength() const { return radixEnabled ? radixCapacity - radixWindow : 0; }
+
+protected:
+    // Init for argsort formats. keysBuffer holds the packed keys and is never
+    // written, the sorter owns the element and index buffers.
+    void InitArgsort(
+      const wgpu::Device& device,
+      const wgpu::Buffer& keysBuffer, 
+      uint32_t maxInputSize, 
+      const wgpu::Buffer& segmentBuffer, 
+      uint32_t maxSegmentSize
+    );
 
 private:
-    const uint32_t nt = 128;
-    const uint32_t nt2 = 64;
-    const uint32_t vt = 15;
-    const uint32_t nv = 1920;
+    const SortFormat format;
+
+    SegmentedSortTile tile;
+    bool tileSet = false;
+    // Geometry of the tile the kernels were built for.
+    uint32_t nt = 128;
+    uint32_t nt2 = 64;
+    uint32_t vt = 15;
+    uint32_t nv = 1920;
+    // Segments starting within radixWindow elements are sorted by one workgroup
+    // holding up to radixCapacity elements, see seg_radix.wgsl.
+    const uint32_t radixWindow = 512;
+    const uint32_t radixCapacity = 1024;
 
     uint32_t maxCount;
     uint32_t maxNumPasses;
     uint32_t maxNumSegments;
     uint32_t maxNumCtas;
     uint32_t maxCapacity;
+    uint32_t maxNumRadixWindows;
+    uint32_t bucketTileCapacity;
     uint32_t previousCount = 0;
+    uint32_t minCount;
+    uint32_t minNumSegments;
+    uint32_t peakCount = 0;
+    uint32_t peakNumSegments = 0;
+    uint32_t idleUploads = 0;
+    SegmentedSortGrowth growth;
+    bool radixEnabled = false;
 
-    void InitBuffers(const wgpu::Device& device);
-    void InitClear(const wgpu::Device& device);
-    void InitPartition(
-        const wgpu::Device& device, 
-        const wgpu::Buffer& inputBuffer
-    );
-    void InitCopy(
-        const wgpu::Device& device, 
-        const wgpu::Buffer& inputBuffer
-    );
-    void InitBlock(
-        const wgpu::Device& device, 
-        const wgpu::Buffer& inputBuffer, 
-        const wgpu::Buffer& segmentsBuffer
-    );
-    void InitBinarySearch(
-        const wgpu::Device& device, 
-        const wgpu::Buffer& segmentsBuffer
-    );
-    void InitMerge(
-        const wgpu::Device& device, 
-        const wgpu::Buffer& inputBuffer
+    // Bind groups of the kernels that read or write the caller buffers.
+    struct BufferBindGroups {
+      wgpu::BindGroup copy[2];
+      wgpu::BindGroup binarySearch;
+      wgpu::BindGroup block[2];
+      wgpu::BindGroup partition[2];
+      wgpu::BindGroup merge[2];
+      wgpu::BindGroup radixBinarySearch;
+      wgpu::BindGroup radix;
+      wgpu::BindGroup bucket;
+      wgpu::BindGroup bucketSort;
+      wgpu::BindGroup index;
+    };
+
+    struct BindGroupCacheEntry {
+      SortBufferRange input;
+      SortBufferRange segments;
+      BufferBindGroups bindGroups;
+    };
+
+    void InitObjects(
+      const wgpu::Device& device,
+      const wgpu::Buffer& inputBuffer, 
+      uint32_t maxInputSize, 
+      const wgpu::Buffer& segmentBuffer, 
+      uint32_t maxSegmentSize
     );
+    void InitBuffers(const wgpu::Device& device, uint32_t maxInputSize, uint32_t maxSegmentSize);
+    void InitBindGroups(const wgpu::Device& device);
+    BufferBindGroups MakeBufferBindGroups(const SortBufferRange& input, const SortBufferRange& segments) const;
+    // Cached bind groups of input and segments, most recently used first.
+    const BufferBindGroups& BindBuffers(const SortBufferRange& input, const SortBufferRange& segments);
+    void DisposeBuffers();
+    // Grows the buffers geometrically when count or segmentCount does not fit.
+    bool Reserve(const wgpu::Device& device, uint32_t count, uint32_t segmentCount);
+    void Reallocate(const wgpu::Device& device, uint32_t newCount, uint32_t newNumSegments);
+    void InitClear(const wgpu::Device& device);
+    void InitPartition(const wgpu::Device& device);
+    void InitCopy(const wgpu::Device& device);
+    void InitOpArgs(const wgpu::Device& device);
+    void InitBlock(const wgpu::Device& device);
+    void InitBinarySearch(const wgpu::Device& device);
+    void InitMerge(const wgpu::Device& device);
+    void InitRadix(const wgpu::Device& device);
+    void InitBuckets(const wgpu::Device& device);
+    void InitArgsortIndices(const wgpu::Device& device);
+    ShaderComposer Composer() const;
+    ComputeUtil::PipelineConstants TileConstants() const;
+    std::string BlockPrelude() const;
+    std::string BucketPrelude() const;
+    void SortSmallSegments(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, const BufferBindGroups& groups, uint32_t count);
+    // Block sort and merge passes. When gated their dispatch sizes come from the
+    // bucket pre-pass and the caller has already cleared the op counters.
+    void EncodeMergePath(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, const BufferBindGroups& groups, uint32_t count, bool gated);
+    void EncodeArgsortIndices(const wgpu::CommandEncoder& encoder, const BufferBindGroups& groups, uint32_t count);
     
+    wgpu::Device device;
+
+    // Caller buffers, the element buffer is owned by the sorter for argsort formats.
+    wgpu::Buffer inputBuffer;
+    wgpu::Buffer segmentsBuffer;
     wgpu::Buffer inputBufferCopy;
     wgpu::Buffer paramBuffer;
     wgpu::Buffer partitionBuffer;
@@ -85,22 +304,94 @@ private:
     wgpu::Buffer compressedRangesBuffer;
     wgpu::Buffer mergeRangesBuffer;
     wgpu::Buffer copyListBuffer;
+    wgpu::Buffer copyStatusBuffer;
     wgpu::Buffer opCounterBuffer;
+    wgpu::Buffer opArgsBuffer;
     wgpu::Buffer mergeListBuffer;
+    wgpu::Buffer radixParamBuffer;
+    wgpu::Buffer radixPartitionBuffer;
+    wgpu::Buffer bucketCounterBuffer;
+    wgpu::Buffer bucketListBuffer;
+    wgpu::Buffer argsortKeysBuffer;
+    wgpu::Buffer indexBuffer;
+
+    wgpu::BindGroupLayout blockLayouts[2];
+    wgpu::BindGroupLayout partitionLayout;
+    wgpu::BindGroupLayout mergeLayout;
+    wgpu::BindGroupLayout binarySearchLayout;
+    wgpu::BindGroupLayout copyLayout;
+    wgpu::BindGroupLayout opArgsLayout;
+    wgpu::BindGroupLayout clearLayout;
+    wgpu::BindGroupLayout radixLayout;
+    wgpu::BindGroupLayout bucketLayout;
+    wgpu::BindGroupLayout bucketArgsLayout;
+    wgpu::BindGroupLayout bucketSortLayout;
+    wgpu::BindGroupLayout indexLayout;
 
+    // Every pipeline is created through this batch, so they compile concurrently.
+    ComputeUtil::PipelineBatch pipelines;
     wgpu::ComputePipeline blockPipeline[2];
+    // Block pipelines of SortBucketed, which skip tiles without a long segment.
+    wgpu::ComputePipeline blockLongPipeline[2];
     wgpu::ComputePipeline partitionPipeline;
     wgpu::ComputePipeline mergePipeline;
     wgpu::ComputePipeline binarySearchPipeline;
     wgpu::ComputePipeline copyPipeline;
+    wgpu::ComputePipeline opArgsPipeline;
     wgpu::ComputePipeline clearPipeline;
+    wgpu::ComputePipeline radixPipeline;
+    wgpu::ComputePipeline bucketPipeline;
+    wgpu::ComputePipeline bucketArgsPipeline;
+    wgpu::ComputePipeline bucketSortPipelines[3];
+    wgpu::ComputePipeline indexPipeline;
 
-    wgpu::BindGroup copyBindGroups[2];
-    wgpu::BindGroup binarySearchBindGroup;
-    wgpu::BindGroup blockBindGroups[2];
-    wgpu::BindGroup partitionBindGroups[2];
-    wgpu::BindGroup mergeBindGroups[2];
     wgpu::BindGroup clearBindGroup;
+    wgpu::BindGroup opArgsBindGroup;
+    wgpu::BindGroup bucketArgsBindGroup;
+
+    std::list<BindGroupCacheEntry> bindGroupCache;
+    uint32_t bindGroupCacheSize = 8;
 
     Param params;
-};
\ No newline at end of file
+    Param radixParams;
+};
+
+template <typename Key = uint32_t, typename Value = uint32_t>
+class SegmentedSort : public SegmentedSortBase {
+public:
+    using Record = SortElement<Key, Value>;
+
+    static_assert(sizeof(Record) == MakeSortFormat<Key, Value>().ElementSize(),
+                  "Record layout does not match the GPU element");
+
+    explicit SegmentedSort(SortOrder order = SortOrder::Ascending)
+        : SegmentedSortBase(MakeSortFormat<Key, Value>(order)) {}
+
+    // comparator is a WGSL expression over a_key and b_key, see SortFormat. Every
+    // sorter compiles its own pipelines, so each comparator gets its own variant.
+    explicit SegmentedSort(const std::string& comparator, SortOrder order = SortOrder::Ascending)
+        : SegmentedSortBase(MakeSortFormat<Key, Value>(order, comparator.c_str())) {}
+};
+
+// Segmented argsort of packed keys: IndexBuffer() receives, per segment, the
+// indices of the keys in sorted order. The indices are generated on the GPU so
+// only the keys are uploaded.
+template <typename Key = uint32_t>
+class SegmentedArgsort : public SegmentedSortBase {
+public:
+    explicit SegmentedArgsort(SortOrder order = SortOrder::Ascending)
+        : SegmentedSortBase(MakeArgsortFormat<Key>(order)) {}
+
+    explicit SegmentedArgsort(const std::string& comparator, SortOrder order = SortOrder::Ascending)
+        : SegmentedSortBase(MakeArgsortFormat<Key>(order, comparator.c_str())) {}
+
+    void Init(
+      const wgpu::Device& device,
+      const wgpu::Buffer& keysBuffer, 
+      uint32_t maxInputSize, 
+      const wgpu::Buffer& segmentBuffer, 
+      uint32_t maxSegmentSize
+    ) {
+        InitArgsort(device, keysBuffer, maxInputSize, segmentBuffer, maxSegmentSize);
+    }
+};
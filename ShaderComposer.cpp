@@ -0,0 +1,164 @@
+#include "ShaderComposer.h"
+
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Imports deeper than this are taken to be cyclic.
+static const int MAX_IMPORT_DEPTH = 16;
+
+static const std::map<std::string, std::string>& LibraryModules() {
+    static const std::map<std::string, std::string> modules = {
+      { "tile",
+        #include "segsort_tuple/lib/tile.wgsl"
+      },
+      { "math",
+        #include "segsort_tuple/lib/math.wgsl"
+      },
+      { "mergesort",
+        #include "segsort_tuple/lib/mergesort.wgsl"
+      },
+      { "merge_path",
+        #include "segsort_tuple/lib/merge_path.wgsl"
+      },
+    };
+    return modules;
+}
+
+static std::string Trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+      return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+ShaderComposer& ShaderComposer::Define(const std::string& name, const std::string& value) {
+    defines[name] = value;
+    return *this;
+}
+
+ShaderComposer& ShaderComposer::Define(const std::string& name, uint32_t value) {
+    return Define(name, std::to_string(value));
+}
+
+ShaderComposer& ShaderComposer::AddModule(const std::string& name, const std::string& source) {
+    modules[name] = source;
+    return *this;
+}
+
+ShaderComposer& ShaderComposer::Prelude(const std::string& source) {
+    prelude += source;
+    return *this;
+}
+
+std::string ShaderComposer::Compose(const std::string& source, const std::string& label) const {
+    std::set<std::string> imported;
+    std::string out;
+    Expand(prelude, label, imported, out, 0);
+    Expand(source, label, imported, out, 0);
+    return out;
+}
+
+void ShaderComposer::Expand(const std::string& source, const std::string& label, std::set<std::string>& imported, std::string& out, int depth) const {
+    if (depth > MAX_IMPORT_DEPTH) {
+      std::cerr << "ShaderComposer: " << label << ": imports nested too deep" << std::endl;
+      exit(1);
+    }
+
+    // One entry per open #if: whether its current branch is taken, and whether
+    // the enclosing lines are.
+    struct Branch { bool taken; bool parent; bool inElse; };
+    std::vector<Branch> branches;
+    auto active = [&]() { return branches.empty() || (branches.back().taken && branches.back().parent); };
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line)) {
+      std::string trimmed = Trim(line);
+      if (trimmed.rfind("#if ", 0) == 0) {
+        bool parent = active();
+        branches.push_back({ parent && Condition(Trim(trimmed.substr(4)), label), parent, false });
+      } else if (trimmed == "#else") {
+        if (branches.empty() || branches.back().inElse) {
+          std::cerr << "ShaderComposer: " << label << ": #else without #if" << std::endl;
+          exit(1);
+        }
+        branches.back().taken = !branches.back().taken;
+        branches.back().inElse = true;
+      } else if (trimmed == "#endif") {
+        if (branches.empty()) {
+          std::cerr << "ShaderComposer: " << label << ": #endif without #if" << std::endl;
+          exit(1);
+        }
+        branches.pop_back();
+      } else if (trimmed.rfind("#import ", 0) == 0) {
+        if (!active()) {
+          continue;
+        }
+        std::string name = Trim(trimmed.substr(8));
+        if (!imported.insert(name).second) {
+          continue;
+        }
+        auto module = modules.find(name);
+        if (module == modules.end()) {
+          module = LibraryModules().find(name);
+          if (module == LibraryModules().end()) {
+            std::cerr << "ShaderComposer: " << label << ": unknown module " << name << std::endl;
+            exit(1);
+          }
+        }
+        Expand(module->second, label, imported, out, depth + 1);
+      } else if (!trimmed.empty() && trimmed[0] == '#') {
+        std::cerr << "ShaderComposer: " << label << ": unknown directive " << trimmed << std::endl;
+        exit(1);
+      } else if (active()) {
+        out += Substitute(line, label);
+        out += '\n';
+      }
+    }
+
+    if (!branches.empty()) {
+      std::cerr << "ShaderComposer: " << label << ": #if without #endif" << std::endl;
+      exit(1);
+    }
+}
+
+std::string ShaderComposer::Substitute(const std::string& line, const std::string& label) const {
+    std::string result;
+    size_t pos = 0;
+    while (true) {
+      size_t begin = line.find("${", pos);
+      if (begin == std::string::npos) {
+        result += line.substr(pos);
+        return result;
+      }
+      size_t end = line.find('}', begin);
+      if (end == std::string::npos) {
+        std::cerr << "ShaderComposer: " << label << ": unterminated ${ in " << Trim(line) << std::endl;
+        exit(1);
+      }
+      std::string name = line.substr(begin + 2, end - begin - 2);
+      auto define = defines.find(name);
+      if (define == defines.end()) {
+        std::cerr << "ShaderComposer: " << label << ": " << name << " is not defined" << std::endl;
+        exit(1);
+      }
+      result += line.substr(pos, begin - pos);
+      result += define->second;
+      pos = end + 1;
+    }
+}
+
+bool ShaderComposer::Condition(const std::string& expression, const std::string& label) const {
+    bool negate = !expression.empty() && expression[0] == '!';
+    std::string name = Trim(negate ? expression.substr(1) : expression);
+    if (name.empty()) {
+      std::cerr << "ShaderComposer: " << label << ": #if without a name" << std::endl;
+      exit(1);
+    }
+    auto define = defines.find(name);
+    bool value = define != defines.end() && define->second != "0" && !define->second.empty();
+    return negate ? !value : value;
+}
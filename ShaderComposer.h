@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <cstdint>
+
+// Composes WGSL kernels from shared snippets, so variants of a kernel are
+// generated instead of copied. Sources go through a line based preprocessor:
+//
+//   #import name         inlines module name, once per composed kernel
+//   #if NAME / #if !NAME includes the lines up to the matching #else or #endif
+//                        when NAME is defined and not 0, or the opposite
+//   ${NAME}              is replaced by the value of NAME
+//
+// Modules are the snippets under segsort_tuple/lib plus the ones added with
+// AddModule. Element type, key and comparator come from the prelude, see
+// SortFormat::ShaderPrelude.
+class ShaderComposer {
+public:
+    ShaderComposer& Define(const std::string& name, const std::string& value);
+    ShaderComposer& Define(const std::string& name, uint32_t value);
+    ShaderComposer& AddModule(const std::string& name, const std::string& source);
+    // Text placed before every kernel composed, preprocessed as well.
+    ShaderComposer& Prelude(const std::string& source);
+
+    // label names the kernel in errors.
+    std::string Compose(const std::string& source, const std::string& label) const;
+
+private:
+    void Expand(const std::string& source, const std::string& label, std::set<std::string>& imported, std::string& out, int depth) const;
+    std::string Substitute(const std::string& line, const std::string& label) const;
+    bool Condition(const std::string& expression, const std::string& label) const;
+
+    std::map<std::string, std::string> defines;
+    std::map<std::string, std::string> modules;
+    std::string prelude;
+};
@@ -0,0 +1,151 @@
+#include "SortPipeline.h"
+
+#include <cstring>
+
+#include "ComputeUtil.h"
+
+// Failing to map a staging buffer is fatal, like the other readback errors.
+static void OnMapped(WGPUBufferMapAsyncStatus status, void*) {
+    if (status != WGPUBufferMapAsyncStatus_Success) {
+      std::cerr << "SortPipeline: failed to map a staging buffer, with status: " << static_cast<int>(status) << std::endl;
+      exit(1);
+    }
+}
+
+SortPipelineBase::SortPipelineBase(const SortFormat& format) : sorter(format) {}
+
+void SortPipelineBase::Init(
+  const std::unique_ptr<wgpu::Instance>& instance,
+  const wgpu::Device& device,
+  uint32_t numSlots,
+  uint32_t maxBatchSize,
+  uint32_t maxBatchSegments,
+  Consumer consumer
+) {
+    this->instance = &instance;
+    this->device = device;
+    this->consumer = std::move(consumer);
+    this->maxBatchSize = maxBatchSize;
+    this->maxBatchSegments = std::max(maxBatchSegments, 1u);
+
+    uint64_t recordBytes = uint64_t(maxBatchSize) * sorter.Format().ElementSize();
+    uint64_t segmentBytes = uint64_t(this->maxBatchSegments) * sizeof(uint32_t);
+    segmentsOffset = recordBytes;
+
+    slots.resize(numSlots);
+    for (Slot& slot : slots) {
+      slot.records = utils::CreateBuffer(device, recordBytes, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "SortPipeline::records");
+      slot.segments = utils::CreateBuffer(device, segmentBytes, wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "SortPipeline::segments");
+
+      // Mapped at creation, so the first batch of every slot does not wait.
+      wgpu::BufferDescriptor desc;
+      desc.size = recordBytes + segmentBytes;
+      desc.usage = wgpu::BufferUsage::MapWrite | wgpu::BufferUsage::CopySrc;
+      desc.mappedAtCreation = true;
+      desc.label = "SortPipeline::upload";
+      slot.upload = device.CreateBuffer(&desc);
+
+      slot.readback = utils::CreateBuffer(device, recordBytes, wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst, "SortPipeline::readback");
+    }
+
+    // Every slot keeps its bind groups cached.
+    sorter.SetBindGroupCacheSize(std::max(numSlots, 8u));
+    sorter.Init(device, slots[0].records, maxBatchSize, slots[0].segments, this->maxBatchSegments);
+}
+
+void SortPipelineBase::Push(const void* records, uint32_t count, const uint32_t* segments, uint32_t segmentCount) {
+    if (count > maxBatchSize || segmentCount > maxBatchSegments) {
+      std::cerr << "SortPipeline: batch of " << count << " records in " << segmentCount << " segments exceeds the capacity of "
+                << maxBatchSize << " records in " << maxBatchSegments << " segments" << std::endl;
+      exit(1);
+    }
+
+    Slot& slot = slots[nextBatch % slots.size()];
+    if (slot.inFlight) {
+      Complete(slot);
+    }
+    if (slot.uploadPending) {
+      Wait(slot.uploadMapped);
+      slot.uploadPending = false;
+    }
+
+    uint64_t recordBytes = uint64_t(count) * sorter.Format().ElementSize();
+    uint64_t segmentBytes = uint64_t(segmentCount) * sizeof(uint32_t);
+    uint8_t* upload = static_cast<uint8_t*>(slot.upload.GetMappedRange());
+    std::memcpy(upload, records, recordBytes);
+    std::memcpy(upload + segmentsOffset, segments, segmentBytes);
+    slot.upload.Unmap();
+
+    // Written through the queue, so it lands after the batches already submitted.
+    if (count > 0) {
+      sorter.Upload(device, count, segmentCount);
+    }
+
+    wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+    encoder.CopyBufferToBuffer(slot.upload, 0, slot.records, 0, recordBytes);
+    if (segmentBytes > 0) {
+      encoder.CopyBufferToBuffer(slot.upload, segmentsOffset, slot.segments, 0, segmentBytes);
+    }
+    if (count > 0) {
+      sorter.Sort(encoder, wgpu::QuerySet(), slot.records, slot.segments, count, segmentCount);
+    }
+    encoder.CopyBufferToBuffer(slot.records, 0, slot.readback, 0, recordBytes);
+    wgpu::CommandBuffer commandBuffer = encoder.Finish();
+    device.GetQueue().Submit(1, &commandBuffer);
+
+    // Both maps complete once the GPU is done with the batch.
+    slot.uploadMapped = slot.upload.MapAsync(
+        wgpu::MapMode::Write, 0, slot.upload.GetSize(),
+        wgpu::BufferMapCallbackInfo{nullptr, wgpu::CallbackMode::WaitAnyOnly, OnMapped, nullptr});
+    slot.uploadPending = true;
+    slot.readbackMapped = slot.readback.MapAsync(
+        wgpu::MapMode::Read, 0, std::max<uint64_t>(recordBytes, 4),
+        wgpu::BufferMapCallbackInfo{nullptr, wgpu::CallbackMode::WaitAnyOnly, OnMapped, nullptr});
+
+    slot.batch = nextBatch++;
+    slot.count = count;
+    slot.inFlight = true;
+}
+
+void SortPipelineBase::Flush() {
+    // Oldest first, the consumer sees the batches in submission order.
+    for (size_t i = 0; i < slots.size(); i++) {
+      Slot& slot = slots[(nextBatch + i) % slots.size()];
+      if (slot.inFlight) {
+        Complete(slot);
+      }
+    }
+}
+
+void SortPipelineBase::Wait(const wgpu::Future& future) {
+    (*instance)->WaitAny(future, UINT64_MAX);
+}
+
+void SortPipelineBase::Complete(Slot& slot) {
+    Wait(slot.readbackMapped);
+
+    uint64_t recordBytes = uint64_t(slot.count) * sorter.Format().ElementSize();
+    consumer(slot.batch, slot.readback.GetConstMappedRange(0, std::max<uint64_t>(recordBytes, 4)), slot.count);
+    slot.readback.Unmap();
+    slot.inFlight = false;
+
+    auto now = high_resolution_clock::now();
+    if (slot.batch == 0) {
+      firstCompleted = now;
+      return;
+    }
+    stats.batches++;
+    stats.records += slot.count;
+    stats.seconds = duration_cast<nanoseconds>(now - firstCompleted).count() / 1e9;
+}
+
+void SortPipelineBase::Dispose() {
+    Flush();
+    sorter.Dispose();
+    for (Slot& slot : slots) {
+      slot.records.Destroy();
+      slot.segments.Destroy();
+      slot.upload.Destroy();
+      slot.readback.Destroy();
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <chrono>
+using namespace std::chrono;
+
+#include <webgpu/webgpu_cpp.h>
+#include "wgpu/WGPUHelpers.h"
+#include "SegSort.h"
+
+struct SortPipelineStats {
+  uint64_t batches = 0;
+  uint64_t records = 0;
+  // Time between the first and the last completed batch. The first batch is
+  // left out of batches and records, so they describe the steady state.
+  double seconds = 0.0;
+
+  double RecordsPerSecond() const { return seconds > 0.0 ? records / seconds : 0.0; }
+};
+
+// Streams batches of records and segment heads through a SegmentedSort with a
+// ring of in-flight slots. Every slot has its own device records and segments
+// buffers, which the sorter sorts through its buffer range overload, an upload
+// staging buffer that is mapped again right after its batch is submitted and a
+// readback staging buffer that the sorted batch is copied to. The upload copy of
+// batch i + 1 does not touch the buffers batch i is sorted in, and while the GPU
+// sorts batch i the host fills the slot of batch i + 1 and consumes the results
+// of the batches before i.
+class SortPipelineBase {
+public:
+    // Called with the sorted records of every batch, in submission order. The
+    // data is only valid during the call.
+    using Consumer = std::function<void(uint64_t batch, const void* records, uint32_t count)>;
+
+    explicit SortPipelineBase(const SortFormat& format);
+
+    void Dispose();
+    void Init(
+      const std::unique_ptr<wgpu::Instance>& instance,
+      const wgpu::Device& device,
+      uint32_t numSlots,
+      uint32_t maxBatchSize,
+      uint32_t maxBatchSegments,
+      Consumer consumer
+    );
+
+    // Queues a batch. Blocks only when every slot is in flight, until the oldest
+    // batch has been consumed.
+    void Push(const void* records, uint32_t count, const uint32_t* segments, uint32_t segmentCount);
+    // Waits for and consumes every batch in flight.
+    void Flush();
+
+    const SortPipelineStats& Stats() const { return stats; }
+
+private:
+    struct Slot {
+      wgpu::Buffer records;
+      wgpu::Buffer segments;
+      wgpu::Buffer upload;
+      wgpu::Buffer readback;
+      wgpu::Future uploadMapped;
+      wgpu::Future readbackMapped;
+      uint64_t batch = 0;
+      uint32_t count = 0;
+      bool inFlight = false;
+      bool uploadPending = false;
+    };
+
+    void Wait(const wgpu::Future& future);
+    // Hands the sorted records of slot to the consumer and frees the slot.
+    void Complete(Slot& slot);
+
+    const std::unique_ptr<wgpu::Instance>* instance = nullptr;
+    wgpu::Device device;
+    SegmentedSortBase sorter;
+    Consumer consumer;
+
+    uint32_t maxBatchSize;
+    uint32_t maxBatchSegments;
+    // Byte offset of the segment heads in the upload buffers.
+    uint64_t segmentsOffset;
+
+    std::vector<Slot> slots;
+    uint64_t nextBatch = 0;
+
+    SortPipelineStats stats;
+    high_resolution_clock::time_point firstCompleted;
+};
+
+template <typename Key = uint32_t, typename Value = uint32_t>
+class SortPipeline : public SortPipelineBase {
+public:
+    using Record = SortElement<Key, Value>;
+
+    explicit SortPipeline(SortOrder order = SortOrder::Ascending)
+        : SortPipelineBase(MakeSortFormat<Key, Value>(order)) {}
+
+    void Push(std::span<const Record> records, std::span<const uint32_t> segments) {
+        SortPipelineBase::Push(records.data(), records.size(), segments.data(), segments.size());
+    }
+};
@@ -0,0 +1,120 @@
+#include "SortTypes.h"
+
+#include <sstream>
+
+namespace {
+const char* KeyTypeName(SortKeyType type) {
+    switch (type) {
+        case SortKeyType::U32:
+            return "u32";
+        case SortKeyType::I32:
+            return "i32";
+        case SortKeyType::F32:
+            return "f32";
+        case SortKeyType::U64:
+            return "u64";
+    }
+    return "";
+}
+
+const char* ValueTypeName(SortValueType type) {
+    switch (type) {
+        case SortValueType::None:
+            return "";
+        case SortValueType::U32:
+            return "u32";
+        case SortValueType::I32:
+            return "i32";
+        case SortValueType::F32:
+            return "f32";
+    }
+    return "";
+}
+}  // namespace
+
+std::string SortFormat::Name() const {
+    std::string name = KeyTypeName(key);
+    if (HasValue()) {
+        name += std::string("_") + ValueTypeName(value);
+    }
+    if (argsort) {
+        name += "_argsort";
+    }
+    if (!comparator.empty()) {
+        name += "_custom";
+    }
+    if (order == SortOrder::Descending) {
+        name += "_desc";
+    }
+    return name;
+}
+
+std::string SortFormat::ShaderPrelude() const {
+    std::stringstream ss;
+    uint32_t words = ElementWords();
+
+    // Key-only 32 bit elements are plain scalars, everything else is a vector
+    // with the key in the leading words.
+    std::string first = words == 1u ? "e" : "e.x";
+    if (words == 1u) {
+        ss << "  alias Elem = u32;\n";
+    } else {
+        ss << "  alias Elem = vec" << words << "<u32>;\n";
+    }
+
+    // key_less(a, b) is the natural ordering of the key type, radix_word maps keys to
+    // unsigned words with the same ordering.
+    std::stringstream less;
+    std::stringstream radix;
+    switch (key) {
+        case SortKeyType::U32:
+            ss << "  alias Key = u32;\n";
+            ss << "  fn key_of(e: Elem) -> Key { return " << first << "; }\n";
+            less << "a_key < b_key";
+            radix << "k";
+            break;
+        case SortKeyType::I32:
+            ss << "  alias Key = i32;\n";
+            ss << "  fn key_of(e: Elem) -> Key { return bitcast<i32>(" << first << "); }\n";
+            less << "a_key < b_key";
+            radix << "bitcast<u32>(k) ^ 0x80000000u";
+            break;
+        case SortKeyType::F32:
+            // NaN keys are not ordered, same as std::less<float>.
+            ss << "  alias Key = f32;\n";
+            ss << "  fn key_of(e: Elem) -> Key { return bitcast<f32>(" << first << "); }\n";
+            less << "a_key < b_key";
+            radix << "select(bitcast<u32>(k) | 0x80000000u, ~bitcast<u32>(k), (bitcast<u32>(k) & 0x80000000u) != 0u)";
+            break;
+        case SortKeyType::U64:
+            // Little endian: x holds the low word, y the high word.
+            ss << "  alias Key = vec2<u32>;\n";
+            ss << "  fn key_of(e: Elem) -> Key { return e.xy; }\n";
+            less << "a_key.y < b_key.y || (a_key.y == b_key.y && a_key.x < b_key.x)";
+            radix << "k[word]";
+            break;
+    }
+
+    ss << "  fn key_less(a_key: Key, b_key: Key) -> bool { return " << (comparator.empty() ? less.str() : comparator) << "; }\n";
+    if (order == SortOrder::Descending) {
+        ss << "  fn comp(a_key: Key, b_key: Key) -> bool { return key_less(b_key, a_key); }\n";
+    } else {
+        ss << "  fn comp(a_key: Key, b_key: Key) -> bool { return key_less(a_key, b_key); }\n";
+    }
+
+    if (HasRadixOrder()) {
+        ss << "  const KEY_WORDS = " << KeyWords() << "u;\n";
+        // Inverting every word reverses the order of the digits.
+        std::string invert = order == SortOrder::Descending ? "~" : "";
+        ss << "  fn radix_word(k: Key, word: u32) -> u32 { return " << invert << "(" << radix.str() << "); }\n";
+    }
+
+    if (words == 1u) {
+        ss << "  fn elem_word(e: Elem) -> u32 { return e; }\n";
+        ss << "  fn word_elem(w: u32) -> Elem { return w; }\n";
+    } else {
+        ss << "  fn elem_word(e: Elem) -> u32 { return e.x; }\n";
+        ss << "  fn word_elem(w: u32) -> Elem { var e = Elem(); e.x = w; return e; }\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Key and payload types supported by the GPU sorters. Elements are stored as
+// 32 bit words on the GPU, so every element layout has to match the natural
+// layout of the corresponding SortElement on the host.
+enum class SortKeyType { U32, I32, F32, U64 };
+enum class SortValueType { None, U32, I32, F32 };
+enum class SortOrder { Ascending, Descending };
+
+// Value tag for key-only sorts, the records are then plain keys.
+struct KeyOnly {};
+
+struct SortFormat {
+    SortKeyType key = SortKeyType::U32;
+    SortValueType value = SortValueType::U32;
+    SortOrder order = SortOrder::Ascending;
+    // Optional WGSL expression over a_key and b_key that replaces the default
+    // ordering of comp, e.g. "abs(a_key) < abs(b_key)" for f32 keys. It must be a
+    // strict weak ordering, order still applies on top of it.
+    std::string comparator;
+    // Argsort formats sort packed keys and generate the element index as the
+    // payload in the first block pass, the value type is then always U32.
+    bool argsort = false;
+
+    constexpr bool HasValue() const { return value != SortValueType::None; }
+    // radix_word only matches comp for the built-in orderings.
+    bool HasRadixOrder() const { return comparator.empty(); }
+    constexpr uint32_t KeyWords() const { return key == SortKeyType::U64 ? 2u : 1u; }
+
+    // Number of 32 bit words per element, padded to a WGSL vector size. vec3<u32>
+    // has a 16 byte stride in storage buffers, and so does a 64 bit key followed
+    // by a 32 bit value on the host.
+    constexpr uint32_t ElementWords() const {
+        uint32_t words = KeyWords() + (HasValue() ? 1u : 0u);
+        return words > 2u ? 4u : words;
+    }
+    constexpr uint32_t ElementSize() const { return ElementWords() * sizeof(uint32_t); }
+
+    std::string Name() const;
+
+    // WGSL declarations shared by all kernels of a sort variant:
+    //   Elem, Key                      - storage element and key types
+    //   key_of(e)                      - extracts the key of an element
+    //   comp(a, b)                     - strict weak ordering on keys, descending
+    //                                    orders swap its arguments
+    //   KEY_WORDS, radix_word(k, i)    - key as unsigned words whose order matches comp,
+    //                                    least significant word first. Only declared
+    //                                    when HasRadixOrder()
+    //   elem_word(e) / word_elem(w)    - raw access to the first word of an element,
+    //                                    used when shared memory is reused for flags
+    std::string ShaderPrelude() const;
+};
+
+template <typename Key, typename Value>
+struct SortRecord {
+    Key key;
+    Value value;
+};
+
+// Host type of a single element: the record, or just the key for KeyOnly sorts.
+template <typename Key, typename Value>
+using SortElement = std::conditional_t<std::is_same_v<Value, KeyOnly>, Key, SortRecord<Key, Value>>;
+
+template <typename Key, typename Value>
+const Key& RecordKey(const SortRecord<Key, Value>& record) {
+    return record.key;
+}
+
+template <typename Key>
+const Key& RecordKey(const Key& key) {
+    return key;
+}
+
+template <typename T>
+struct SortKeyTraits;
+
+template <>
+struct SortKeyTraits<uint32_t> {
+    static constexpr SortKeyType type = SortKeyType::U32;
+};
+
+template <>
+struct SortKeyTraits<int32_t> {
+    static constexpr SortKeyType type = SortKeyType::I32;
+};
+
+template <>
+struct SortKeyTraits<float> {
+    static constexpr SortKeyType type = SortKeyType::F32;
+};
+
+template <>
+struct SortKeyTraits<uint64_t> {
+    static constexpr SortKeyType type = SortKeyType::U64;
+};
+
+template <typename T>
+struct SortValueTraits;
+
+template <>
+struct SortValueTraits<KeyOnly> {
+    static constexpr SortValueType type = SortValueType::None;
+};
+
+template <>
+struct SortValueTraits<uint32_t> {
+    static constexpr SortValueType type = SortValueType::U32;
+};
+
+template <>
+struct SortValueTraits<int32_t> {
+    static constexpr SortValueType type = SortValueType::I32;
+};
+
+template <>
+struct SortValueTraits<float> {
+    static constexpr SortValueType type = SortValueType::F32;
+};
+
+template <typename Key, typename Value>
+constexpr SortFormat MakeSortFormat(SortOrder order = SortOrder::Ascending, const char* comparator = "") {
+    SortFormat format;
+    format.key = SortKeyTraits<Key>::type;
+    format.value = SortValueTraits<Value>::type;
+    format.order = order;
+    format.comparator = comparator;
+    return format;
+}
+
+template <typename Key>
+SortFormat MakeArgsortFormat(SortOrder order = SortOrder::Ascending, const char* comparator = "") {
+    SortFormat format = MakeSortFormat<Key, uint32_t>(order, comparator);
+    format.argsort = true;
+    return format;
+}
@@ -1,72 +1,161 @@
 #include "Subgroups.h"
 
 #include "ComputeUtil.h"
+#include "ShaderComposer.h"
 
 struct UniformData {
   uint32_t count;
-  uint32_t step;
+  uint32_t width;
   uint32_t padding0;
   uint32_t padding1;
 };
 
 void SubgroupSort::Init(const wgpu::Device& device, const wgpu::Buffer& inputBuffer, uint32_t inputSize) {
-    auto bgl = utils::MakeBindGroupLayout(
-    device, "SubgroupsSort", {
+    // The tile rank takes the first word of the ballots, any other subgroup
+    // width would silently produce wrong ranks.
+    wgpu::AdapterPropertiesSubgroups subgroups{};
+    wgpu::AdapterProperties properties{};
+    properties.nextInChain = &subgroups;
+    device.GetAdapter().GetProperties(&properties);
+    if (subgroups.subgroupMinSize != 32 || subgroups.subgroupMaxSize != 32) {
+      std::cerr << "SubgroupSort: needs 32-lane subgroups, adapter has " << subgroups.subgroupMinSize << "-" << subgroups.subgroupMaxSize << std::endl;
+      exit(1);
+    }
+
+    maxCount = inputSize;
+    maxNumPasses = ComputeUtil::find_log2(ComputeUtil::div_up(maxCount, tileSize), true);
+
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    uniformStride = std::max<uint32_t>(sizeof(UniformData), limits.limits.minUniformBufferOffsetAlignment);
+
+    // Slot 0 holds the block sort parameters, slot 1 + i those of merge pass i.
+    uniformBuffer = utils::CreateBuffer(device, (maxNumPasses + 1) * uniformStride, wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst, "SubgroupUniforms");
+    scratchBuffer = utils::CreateBuffer(device, maxCount * sizeof(uint32_t), wgpu::BufferUsage::Storage, "SubgroupSort::scratch");
+
+    ComputeUtil::PipelineBatch pipelines;
+
+    // The in place variant has no output binding, writable storage bindings
+    // must not alias.
+    auto blockBgl0 = pipelines.Layout(
+    device, "SubgroupsSort0", {
         { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
-        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
+    });
+
+    auto blockBgl1 = pipelines.Layout(
+    device, "SubgroupsSort1", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform },
     });
 
-  pipeline = ComputeUtil::CreatePipeline(device, bgl,
-    #include "subgroups/sort.wgsl"
-    , "Sort::Subgroups"
+  pipelines.Add(device, blockBgl0,
+    ShaderComposer().Define("IN_PLACE", 1u).Compose(
+      #include "subgroups/sort.wgsl"
+      , "subgroups/sort"
+    ), "Sort::Subgroups0", &blockPipelines[0]
+  );
+
+  pipelines.Add(device, blockBgl1,
+    ShaderComposer().Define("IN_PLACE", 0u).Compose(
+      #include "subgroups/sort.wgsl"
+      , "subgroups/sort"
+    ), "Sort::Subgroups1", &blockPipelines[1]
   );
 
-  uniformBuffer = utils::CreateBuffer(device, sizeof(UniformData), wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst, "SubgroupUniforms");
+  blockBindGroups[0] = utils::MakeBindGroup(
+    device, blockBgl0,
+        {
+          { 0, inputBuffer },
+          { 2, uniformBuffer, 0, sizeof(UniformData) }
+    });
 
-  bindGroup = utils::MakeBindGroup(
-    device, bgl,
+  blockBindGroups[1] = utils::MakeBindGroup(
+    device, blockBgl1,
         {
           { 0, inputBuffer },
-          { 1, uniformBuffer }
+          { 1, scratchBuffer },
+          { 2, uniformBuffer, 0, sizeof(UniformData) }
     });
+
+    auto mergeBgl = pipelines.Layout(
+    device, "SubgroupsMerge", {
+        { 0, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::ReadOnlyStorage },
+        { 1, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Storage },
+        { 2, wgpu::ShaderStage::Compute, wgpu::BufferBindingType::Uniform, true },
+    });
+
+  pipelines.Add(device, mergeBgl,
+    #include "subgroups/merge.wgsl"
+    , "Sort::SubgroupsMerge", &mergePipeline
+  );
+
+  mergeBindGroups[0] = utils::MakeBindGroup(
+    device, mergeBgl,
+        {
+          { 0, inputBuffer },
+          { 1, scratchBuffer },
+          { 2, uniformBuffer, 0, sizeof(UniformData) }
+    });
+
+  mergeBindGroups[1] = utils::MakeBindGroup(
+    device, mergeBgl,
+        {
+          { 0, scratchBuffer },
+          { 1, inputBuffer },
+          { 2, uniformBuffer, 0, sizeof(UniformData) }
+    });
+
+  pipelines.Wait(device);
 }
 
 void SubgroupSort::Upload(const wgpu::Device& device, uint32_t count) {
-    uint32_t numWgs = ComputeUtil::div_up(count, 32);
-   
-    UniformData data;
-    data.count = count;
-
-    if (numWgs >= 0xffffu) {
-      uint32_t x = static_cast<uint32_t>(std::sqrt(static_cast<double>(numWgs)));
-      data.step = x;
-    } else {
-      data.step = 1u;
+    if (count > maxCount) {
+      std::cerr << "SubgroupSort: need to resize (" << count  << "," << maxCount << ")";
+      exit(1);
     }
 
-    device.GetQueue().WriteBuffer(uniformBuffer, 0, &data, sizeof(UniformData));
-}
+    std::vector<uint8_t> data((maxNumPasses + 1) * uniformStride);
+    uint32_t width = tileSize;
+    for (uint32_t slot = 0; slot <= maxNumPasses; slot++) {
+      UniformData* uniforms = reinterpret_cast<UniformData*>(data.data() + slot * uniformStride);
+      uniforms->count = count;
+      uniforms->width = width;
+      if (slot > 0) {
+        width *= 2;
+      }
+    }
 
+    device.GetQueue().WriteBuffer(uniformBuffer, 0, data.data(), data.size());
+}
 
 void SubgroupSort::Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count) {
+    uint32_t numTiles = ComputeUtil::div_up(count, tileSize);
+    uint32_t numPasses = ComputeUtil::find_log2(numTiles, true);
+
+    // Pick the block output so that the last merge pass ends up in the input buffer.
+    uint32_t bindGroupIndex = 1 & numPasses;
+
     auto sortPass = ComputeUtil::CreateTimestampedComputePass(encoder, querySet, 0);
-    
-    uint32_t numWgs = ComputeUtil::div_up(count, 32);
-
-    sortPass.SetPipeline(pipeline);
-    sortPass.SetBindGroup(0, bindGroup);
-
-  if (numWgs >= 0xffffu) {
-      uint32_t x = static_cast<uint32_t>(std::sqrt(static_cast<double>(numWgs)));
-      uint32_t y = x + 1;
-      sortPass.DispatchWorkgroups(x, y);
-    } else {
-      sortPass.DispatchWorkgroups(numWgs);
+
+    sortPass.SetPipeline(blockPipelines[bindGroupIndex]);
+    sortPass.SetBindGroup(0, blockBindGroups[bindGroupIndex]);
+    ComputeUtil::DispatchLinear(sortPass, numTiles);
+
+    uint32_t numMergeWgs = ComputeUtil::div_up(count, mergeKeysPerWorkgroup);
+    sortPass.SetPipeline(mergePipeline);
+    for (uint32_t pass = 0; pass < numPasses; pass++) {
+      uint32_t offset = (pass + 1) * uniformStride;
+      sortPass.SetBindGroup(0, mergeBindGroups[bindGroupIndex % 2], 1, &offset);
+      ComputeUtil::DispatchLinear(sortPass, numMergeWgs);
+      bindGroupIndex++;
     }
-    
+
     sortPass.End();
 }
 
 void SubgroupSort::Dispose() {
-
-}
\ No newline at end of file
+    uniformBuffer.Destroy();
+    scratchBuffer.Destroy();
+}
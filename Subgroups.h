@@ -7,7 +7,10 @@ using namespace std::chrono;
 #include <webgpu/webgpu_cpp.h>
 #include "wgpu/WGPUHelpers.h"
 
-
+// Device-wide sort of u32 keys. A subgroup ballot block sort produces sorted
+// tiles of 1024 keys, which are then merged pairwise with global merge path passes.
+// The ballot ranks assume 32-lane subgroups, Init refuses adapters that may
+// run the kernels at any other width.
 class SubgroupSort {
 public:
     void Dispose();
@@ -20,7 +23,17 @@ public:
     void Upload(const wgpu::Device& device, uint32_t count);
     void Sort(const wgpu::CommandEncoder& encoder, const wgpu::QuerySet& querySet, uint32_t count);
 private:
-    wgpu::ComputePipeline pipeline;
-    wgpu::BindGroup bindGroup;
+    const uint32_t tileSize = 1024;
+    const uint32_t mergeKeysPerWorkgroup = 256 * 8;
+
+    uint32_t maxCount;
+    uint32_t maxNumPasses;
+    uint32_t uniformStride;
+
+    wgpu::ComputePipeline blockPipelines[2];
+    wgpu::ComputePipeline mergePipeline;
+    wgpu::BindGroup blockBindGroups[2];
+    wgpu::BindGroup mergeBindGroups[2];
     wgpu::Buffer uniformBuffer;
-};
\ No newline at end of file
+    wgpu::Buffer scratchBuffer;
+};
@@ -0,0 +1,128 @@
+#include "TileProfile.h"
+
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+static std::mutex profileMutex;
+static std::string profilePath = TileProfile::DefaultPath();
+
+// The part of an entry before the tile.
+static std::string EntryKey(const wgpu::Adapter& adapter, const SortFormat& format) {
+    wgpu::AdapterProperties properties;
+    adapter.GetProperties(&properties);
+
+    // Tabs and newlines would break the line format.
+    std::string name = properties.name;
+    std::string driver = properties.driverDescription;
+    for (std::string* s : { &name, &driver }) {
+      for (char& c : *s) {
+        if (c == '\t' || c == '\n' || c == '\r') {
+          c = ' ';
+        }
+      }
+    }
+    return name + "\t" + driver + "\t" + format.Name() + "\t";
+}
+
+std::string TileProfile::DefaultPath() {
+    const char* path = std::getenv("SEGSORT_TILE_PROFILE");
+    return path ? path : "segsort_tiles.txt";
+}
+
+void TileProfile::SetPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    profilePath = path;
+}
+
+std::string TileProfile::Path() {
+    std::lock_guard<std::mutex> lock(profileMutex);
+    return profilePath;
+}
+
+bool TileProfile::Lookup(const wgpu::Adapter& adapter, const SortFormat& format, SegmentedSortTile* tile) {
+    std::string key = EntryKey(adapter, format);
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    std::ifstream file(profilePath);
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.rfind(key, 0) != 0) {
+        continue;
+      }
+      std::istringstream values(line.substr(key.size()));
+      SegmentedSortTile entry;
+      if (values >> entry.nt >> entry.vt >> entry.nt2) {
+        *tile = entry;
+        return true;
+      }
+    }
+    return false;
+}
+
+// Holds an advisory lock on <path>.lock for its lifetime. The profile itself is
+// replaced by rename, so the lock lives in a file of its own.
+struct ProfileLock {
+    explicit ProfileLock(const std::string& path) {
+      fd = open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+      if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        std::cerr << "TileProfile: cannot lock " << path << ".lock: " << std::strerror(errno) << std::endl;
+        exit(1);
+      }
+    }
+    ~ProfileLock() { close(fd); }
+
+    int fd;
+};
+
+// The read-modify-write runs under the profile lock, so tuners in other
+// processes storing other entries keep each other's. The new profile goes to a
+// temporary file named after the process and thread and is renamed into place,
+// so Lookup never reads a partial profile.
+void TileProfile::Store(const wgpu::Adapter& adapter, const SortFormat& format, const SegmentedSortTile& tile) {
+    std::string key = EntryKey(adapter, format);
+
+    std::lock_guard<std::mutex> lock(profileMutex);
+    ProfileLock fileLock(profilePath);
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(profilePath);
+      std::string line;
+      while (std::getline(file, line)) {
+        if (!line.empty() && line.rfind(key, 0) != 0) {
+          lines.push_back(line);
+        }
+      }
+    }
+    lines.push_back(key + std::to_string(tile.nt) + " " + std::to_string(tile.vt) + " " + std::to_string(tile.nt2));
+
+    std::stringstream suffix;
+    suffix << ".tmp" << getpid() << "." << std::this_thread::get_id();
+    std::string temporary = profilePath + suffix.str();
+    {
+      std::ofstream file(temporary, std::ios::trunc);
+      for (const std::string& line : lines) {
+        file << line << "\n";
+      }
+      if (!file) {
+        std::cerr << "TileProfile: failed to write " << temporary << std::endl;
+        exit(1);
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, profilePath, error);
+    if (error) {
+      std::cerr << "TileProfile: failed to replace " << profilePath << ": " << error.message() << std::endl;
+      exit(1);
+    }
+}
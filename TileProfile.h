@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include <webgpu/webgpu_cpp.h>
+#include "SortTypes.h"
+#include "SegSort.h"
+
+// Tiles picked by the autotuner, see AutotuneSegmentedSort, persisted in a text
+// file with one line per adapter and format:
+//
+//   <adapter name> \t <driver> \t <format name> \t <nt> <vt> <nt2>
+//
+// SegmentedSort looks its tile up at Init. The file is DefaultPath() unless
+// SetPath is called, which must happen before any sorter is initialized.
+class TileProfile {
+public:
+    // SEGSORT_TILE_PROFILE, or segsort_tiles.txt in the working directory.
+    static std::string DefaultPath();
+    static void SetPath(const std::string& path);
+    static std::string Path();
+
+    // Leaves tile as is and returns false when there is no entry.
+    static bool Lookup(const wgpu::Adapter& adapter, const SortFormat& format, SegmentedSortTile* tile);
+    // Adds or replaces the entry of adapter and format.
+    static void Store(const wgpu::Adapter& adapter, const SortFormat& format, const SegmentedSortTile& tile);
+};
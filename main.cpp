@@ -1,12 +1,26 @@
 #include <iostream>
 #include <sstream>
+#include <functional>
 
 #include "ComputeUtil.h"
 #include "SegSort.h"
+#include "RadixSort.h"
+#include "GlobalMergeSort.h"
+#include "ChunkedSort.h"
+#include "ExternalSort.h"
+#include "ReadbackPool.h"
+#include "SortPipeline.h"
+#include "BatchedSort.h"
+#include "PipelineCache.h"
+#include "PipelineLibrary.h"
+#include "ShaderComposer.h"
+#include "Autotune.h"
 #include "Subgroups.h"
 #include "wgpu/NativeUtils.h"
 
 static std::unique_ptr<wgpu::Instance> instance;
+static std::unique_ptr<ReadbackPool> readback;
+static std::unique_ptr<PipelineCache> pipelineCache;
 
 static const wgpu::BufferUsage storageUsage = wgpu::BufferUsage::Storage;
 static const wgpu::BufferUsage copyDstUsage = storageUsage | wgpu::BufferUsage::CopyDst;
@@ -36,9 +50,9 @@ struct QueryContainer {
         encoder.ResolveQuerySet(querySet, 0, numQueries, buffer, 0);
     }
 
-    void Read(const wgpu::Device& device) {
+    void Read() {
         std::vector<uint64_t> queryData =
-            ComputeUtil::CopyReadBackBuffer<uint64_t>(device, buffer, numQueries * sizeof(uint64_t));
+            readback->Read<uint64_t>(buffer, numQueries * sizeof(uint64_t)).get();
 
         for (int i = 0; i < numQueries / 2; i++) {
             gpu_times[i] += queryData[i * 2 + 1] - queryData[i * 2];
@@ -73,8 +87,10 @@ std::string PrintPos(const uint2& p) {
     return ss.str();
 }
 
-void TestSubgroups(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
-    SubgroupSort sorter;
+// Benchmarks and validates a device-wide sort of u32 keys, Sorter is SubgroupSort or RadixSort.
+template <typename Sorter>
+void TestKeySort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device, const char* name) {
+    Sorter sorter;
     QueryContainer queryContainer(device, 2);
     uint32_t iterations = 10;
 
@@ -89,7 +105,7 @@ void TestSubgroups(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::
 
     uint64_t total = 0u;
     for (int i = 0; i < iterations; i++) {
-        std::vector<uint32_t> data = ComputeUtil::fill_random_cpu(0, UINT32_MAX, count, false);
+        data = ComputeUtil::fill_random_cpu(0, UINT32_MAX, count, false);
         queryContainer.Reset();
         wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
         encoder.WriteBuffer(inputBuffer, 0, reinterpret_cast<const uint8_t*>(data.data()),
@@ -102,38 +118,49 @@ void TestSubgroups(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::
         auto commandBuffer = encoder.Finish();
         device.GetQueue().Submit(1, &commandBuffer);
         ComputeUtil::BusyWaitDevice(instance, device);
-        queryContainer.Read(device);
+        queryContainer.Read();
         total += queryContainer.GetTotal();
     }
 
-    std::cout << "Total: " << total / static_cast<float>(1000 * 1000 * iterations) << " " << total << std::endl;
+    float ms = total / static_cast<float>(1000 * 1000 * iterations);
+    std::cout << name << " total: " << ms << " ms " << count / (ms * 1000.f) << " Mkeys/s" << std::endl;
 
-    std::vector<uint32_t> output =
-        ComputeUtil::CopyReadBackBuffer<uint32_t>(device, inputBuffer, count * sizeof(uint32_t));
+    MappedRange mapped = readback->Map(inputBuffer, count * sizeof(uint32_t)).get();
+    if (!mapped) {
+        std::cerr << name << ": failed to map the sorted keys" << std::endl;
+        exit(1);
+    }
+    std::span<const uint32_t> output = mapped.As<uint32_t>();
 
-    for (int i = 0; i < count; i += 32) {
-        uint32_t last = 0u;
-        for (int j = 0; j < 32; j++) {
-            uint32_t v = output[i + j];
-            if (v < last) {
-                std::cerr << "Sort failed: " << i + j << std::endl;
-                exit(1);
-            }
-            // seen[v] = true;
-            last = v;
+    // data holds the input of the last iteration
+    std::sort(data.begin(), data.end());
+    for (int i = 0; i < count; i++) {
+        if (output[i] != data[i]) {
+            std::cerr << "Sort failed: " << i << ": " << output[i] << " expected: " << data[i] << std::endl;
+            exit(1);
         }
     }
+
+    sorter.Dispose();
+    inputBuffer.Destroy();
 }
 
-void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+// With maxSegmentLength set the segment lengths are bounded by it and the sorter
+// is told so, which lets it take the segmented radix path. With bucketed set the
+// sorter buckets the segments by length on the GPU instead. Less is the host
+// ordering the output of the given order and comparator is checked against.
+template <typename Key, typename Value, typename Less = std::less<Key>>
+void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device, uint32_t maxSegmentLength = 0, bool bucketed = false,
+                 SortOrder order = SortOrder::Ascending, const std::string& comparator = "") {
+    using Record = SortElement<Key, Value>;
     const int iterations = 20;
 
-    SegmentedSort sorter;
+    SegmentedSort<Key, Value> sorter(comparator, order);
     const uint32_t maxCount = 12000000;
     int maxNumSegments = ComputeUtil::div_up(maxCount, 100);
 
     wgpu::Buffer inputBuffer = utils::CreateBuffer(
-        device, maxCount * sizeof(int2),
+        device, maxCount * sizeof(Record),
         wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "InputBuffer");
 
     wgpu::Buffer segmentsBuffer =
@@ -143,7 +170,8 @@ void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::De
     const uint32_t numQueries = 8;
     QueryContainer queryContainer(device, numQueries);
 
-    sorter.Init(device, inputBuffer, maxCount, segmentsBuffer, maxNumSegments);
+    // Start small, Upload grows the sorter to the requested sizes.
+    sorter.Init(device, inputBuffer, 1u << 16, segmentsBuffer, 1024);
     for (uint32_t count = 2000000; count <= 2000000; count += count / 10) {
         uint64_t cpu_time = 0;
         // std::array<uint64_t, numQueries / 2> gpu_times;
@@ -156,17 +184,41 @@ void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::De
         int numSegments = ComputeUtil::div_up(count, 100);
 
         for (uint32_t it = 0; it < iterations; it++) {
-            std::vector<uint2> vec = ComputeUtil::fill_random_pairs(0, UINT32_MAX, count);
-            std::vector<uint32_t> segments = ComputeUtil::fill_random_cpu(0u, count - 1, numSegments, true);
+            std::vector<Record> vec = ComputeUtil::fill_random_records<Key, Value>(count);
+            if (bucketed) {
+                // Few distinct keys with the input position as payload, so the
+                // payloads show whether equal keys keep their input order.
+                std::vector<uint32_t> keys = ComputeUtil::fill_random_cpu(0, 255, count, false);
+                for (size_t i = 0; i < vec.size(); i++) {
+                    if constexpr (std::is_same_v<Value, KeyOnly>) {
+                        vec[i] = static_cast<Key>(keys[i]);
+                    } else {
+                        vec[i].key = static_cast<Key>(keys[i]);
+                        vec[i].value = static_cast<Value>(i);
+                    }
+                }
+            }
+            std::vector<uint32_t> segments = maxSegmentLength > 0
+                ? ComputeUtil::fill_random_segments(count, maxSegmentLength)
+                : ComputeUtil::fill_random_cpu(0u, count - 1, numSegments, true);
+            numSegments = segments.size();
 
-            device.GetQueue().WriteBuffer(inputBuffer, 0, vec.data(), vec.size() * sizeof(uint2));
+            device.GetQueue().WriteBuffer(inputBuffer, 0, vec.data(), vec.size() * sizeof(Record));
             device.GetQueue().WriteBuffer(segmentsBuffer, 0, segments.data(), segments.size() * sizeof(int));
-            sorter.Upload(device, count, numSegments);
+            if (!sorter.Upload(device, count, numSegments)) {
+                std::cerr << "TestSegsort: " << count << " records do not fit the device" << std::endl;
+                exit(1);
+            }
 
             ComputeUtil::BusyWaitDevice(instance, device);
 
             wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
-            sorter.Sort(encoder, queryContainer.querySet, count, numSegments);
+            if (bucketed) {
+                sorter.SortBucketed(encoder, queryContainer.querySet, count, numSegments);
+            } else {
+                sorter.Sort(encoder, queryContainer.querySet, count, numSegments,
+                            maxSegmentLength > 0 ? maxSegmentLength : UINT32_MAX);
+            }
             queryContainer.Resolve(encoder);
             auto commandBuffer = encoder.Finish();
 
@@ -174,36 +226,43 @@ void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::De
 
             device.GetQueue().Submit(1, &commandBuffer);
             ComputeUtil::BusyWaitDevice(instance, device);
-            queryContainer.Read(device);
+            queryContainer.Read();
 
             auto t1 = high_resolution_clock::now();
 
             cpu_time += duration_cast<nanoseconds>(t1 - t0).count();
 
-            auto cmp = [](const uint2& a, const uint2& b) -> bool { return a.x < b.x; };
+            auto cmp = [](const Record& a, const Record& b) -> bool { return Less()(RecordKey(a), RecordKey(b)); };
 
-            std::vector<uint2> output =
-                ComputeUtil::CopyReadBackBuffer<uint2>(device, inputBuffer, count * sizeof(int2));
+            std::vector<Record> output =
+                readback->Read<Record>(inputBuffer, count * sizeof(Record)).get();
 
-            std::vector<uint2> copy = vec;
+            std::vector<Record> copy = vec;
             int cur = 0;
             for (int seg = 0; seg < segments.size(); seg++) {
                 int next = segments[seg];
-                std::sort(copy.data() + cur, copy.data() + next, cmp);
+                std::stable_sort(copy.data() + cur, copy.data() + next, cmp);
                 cur = next;
             }
-            std::sort(copy.data() + cur, copy.data() + vec.size(), cmp);
+            std::stable_sort(copy.data() + cur, copy.data() + vec.size(), cmp);
 
             for (int i = 0; i < output.size(); i++) {
-                if (copy[i].x != output[i].x) {
-                    std::cerr << "Faulty at count " << count << " - i:" << i << ": " << PrintPos(output[i])
-                              << " expected: " << PrintPos(copy[i]) << std::endl;
+                if (RecordKey(copy[i]) != RecordKey(output[i])) {
+                    std::cerr << "Faulty at count " << count << " - i:" << i << ": " << RecordKey(output[i])
+                              << " expected: " << RecordKey(copy[i]) << std::endl;
                     exit(1);
                 }
+                if constexpr (!std::is_same_v<Value, KeyOnly>) {
+                    if (bucketed && copy[i].value != output[i].value) {
+                        std::cerr << "Unstable at count " << count << " - i:" << i << ": " << output[i].value
+                                  << " expected: " << copy[i].value << std::endl;
+                        exit(1);
+                    }
+                }
             }
         }
 
-        std::cout << count << " " << (cpu_time / iterations) / 1000 << std::endl;
+        std::cout << sorter.Format().Name() << " " << count << " " << (cpu_time / iterations) / 1000 << std::endl;
         uint64_t tot_gpu = 0u;
 
         auto& gpu_times = queryContainer.GetTimings();
@@ -220,7 +279,677 @@ void TestSegsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::De
     segmentsBuffer.Destroy();
 }
 
-int main() {
+// Window 0 of the segmented radix path holds a single listed head, so its
+// elements before that head form a second, implicit segment. Heads are a radix
+// window apart and every segment is short enough for the radix path.
+void TestSegsortLeadingSegment(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    using Record = SortElement<uint32_t, uint32_t>;
+    const uint32_t count = 1u << 16u;
+    const uint32_t window = 512;
+    const int iterations = 20;
+
+    std::vector<uint32_t> heads;
+    wgpu::Buffer inputBuffer = utils::CreateBuffer(device, count * sizeof(Record), copyAllUsage, "InputBuffer");
+    wgpu::Buffer segmentsBuffer = utils::CreateBuffer(device, count / window * sizeof(uint32_t), copyDstUsage, "SegmentsBuffer");
+
+    SegmentedSort<uint32_t, uint32_t> sorter;
+    sorter.Init(device, inputBuffer, count, segmentsBuffer, count / window);
+
+    auto cmp = [](const Record& a, const Record& b) { return a.key < b.key; };
+    for (int it = 0; it < iterations; it++) {
+        uint32_t first = 1 + it * (window - 2) / (iterations - 1);
+        heads.clear();
+        for (uint32_t head = first; head < count; head += window) {
+            heads.push_back(head);
+        }
+
+        std::vector<Record> vec = ComputeUtil::fill_random_records<uint32_t, uint32_t>(count);
+        device.GetQueue().WriteBuffer(inputBuffer, 0, vec.data(), count * sizeof(Record));
+        device.GetQueue().WriteBuffer(segmentsBuffer, 0, heads.data(), heads.size() * sizeof(uint32_t));
+        if (!sorter.Upload(device, count, heads.size())) {
+            std::cerr << "TestSegsortLeadingSegment: " << count << " records do not fit the device" << std::endl;
+            exit(1);
+        }
+
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        sorter.Sort(encoder, wgpu::QuerySet(), count, heads.size(), window);
+        auto commandBuffer = encoder.Finish();
+        device.GetQueue().Submit(1, &commandBuffer);
+        ComputeUtil::BusyWaitDevice(instance, device);
+
+        std::vector<Record> output = readback->Read<Record>(inputBuffer, count * sizeof(Record)).get();
+
+        uint32_t cur = 0;
+        for (uint32_t head : heads) {
+            std::sort(vec.begin() + cur, vec.begin() + head, cmp);
+            cur = head;
+        }
+        std::sort(vec.begin() + cur, vec.end(), cmp);
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (output[i].key != vec[i].key) {
+                std::cerr << "Faulty with first head " << first << " - i:" << i << ": " << output[i].key
+                          << " expected: " << vec[i].key << std::endl;
+                exit(1);
+            }
+        }
+    }
+    std::cout << "segsort-leading-segment passed" << std::endl;
+
+    sorter.Dispose();
+    inputBuffer.Destroy();
+    segmentsBuffer.Destroy();
+}
+
+// Only the keys are uploaded, the indices come back from IndexBuffer(). Checks
+// that the indices pick out the keys of every segment in sorted order.
+template <typename Key>
+void TestArgsort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    const int iterations = 20;
+
+    SegmentedArgsort<Key> sorter;
+    const uint32_t maxCount = 12000000;
+    int maxNumSegments = ComputeUtil::div_up(maxCount, 100);
+
+    wgpu::Buffer keysBuffer = utils::CreateBuffer(
+        device, maxCount * sizeof(Key), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "KeysBuffer");
+
+    wgpu::Buffer segmentsBuffer =
+        utils::CreateBuffer(device, maxNumSegments * sizeof(int),
+                            wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst, "SegmentsBuffer");
+
+    const uint32_t numQueries = 8;
+    QueryContainer queryContainer(device, numQueries);
+
+    sorter.Init(device, keysBuffer, maxCount, segmentsBuffer, maxNumSegments);
+    for (uint32_t count = 2000000; count <= 2000000; count += count / 10) {
+        uint64_t cpu_time = 0;
+        queryContainer.Reset();
+
+        for (uint32_t it = 0; it < iterations; it++) {
+            std::vector<Key> keys = ComputeUtil::fill_random_records<Key, KeyOnly>(count);
+            std::vector<uint32_t> segments = ComputeUtil::fill_random_cpu(0u, count - 1, ComputeUtil::div_up(count, 100), true);
+
+            device.GetQueue().WriteBuffer(keysBuffer, 0, keys.data(), keys.size() * sizeof(Key));
+            device.GetQueue().WriteBuffer(segmentsBuffer, 0, segments.data(), segments.size() * sizeof(int));
+            if (!sorter.Upload(device, count, segments.size())) {
+                std::cerr << "TestArgsort: " << count << " keys do not fit the device" << std::endl;
+                exit(1);
+            }
+
+            ComputeUtil::BusyWaitDevice(instance, device);
+
+            wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+            sorter.Sort(encoder, queryContainer.querySet, count, segments.size());
+            queryContainer.Resolve(encoder);
+            auto commandBuffer = encoder.Finish();
+
+            auto t0 = high_resolution_clock::now();
+
+            device.GetQueue().Submit(1, &commandBuffer);
+            ComputeUtil::BusyWaitDevice(instance, device);
+            queryContainer.Read();
+
+            auto t1 = high_resolution_clock::now();
+
+            cpu_time += duration_cast<nanoseconds>(t1 - t0).count();
+
+            std::vector<uint32_t> indices =
+                readback->Read<uint32_t>(sorter.IndexBuffer(), count * sizeof(uint32_t)).get();
+
+            std::vector<Key> copy = keys;
+            int cur = 0;
+            for (int seg = 0; seg <= segments.size(); seg++) {
+                int next = seg < segments.size() ? segments[seg] : count;
+                std::sort(copy.data() + cur, copy.data() + next);
+                for (int i = cur; i < next; i++) {
+                    if (indices[i] < cur || indices[i] >= next || keys[indices[i]] != copy[i]) {
+                        std::cerr << "Faulty at count " << count << " - i:" << i << ": index " << indices[i] << std::endl;
+                        exit(1);
+                    }
+                }
+                cur = next;
+            }
+        }
+
+        std::cout << sorter.Format().Name() << " " << count << " " << (cpu_time / iterations) / 1000 << std::endl;
+    }
+
+    sorter.Dispose();
+    keysBuffer.Destroy();
+    segmentsBuffer.Destroy();
+}
+
+// Sorts a few chunks worth of u32 keys through ChunkedSort. chunkSize is kept
+// small so that the run merge is exercised without multi-GB inputs.
+void TestChunkedSort(const wgpu::Device& device, uint32_t chunkSize) {
+    ChunkedSort sorter;
+    sorter.Init(device, chunkSize);
+
+    size_t count = size_t(sorter.ChunkSize()) * 5 + 12345;
+    std::vector<uint32_t> data = ComputeUtil::fill_random_cpu(0, UINT32_MAX, count, false);
+    std::vector<uint32_t> expected = data;
+
+    auto start = high_resolution_clock::now();
+    sorter.Sort(device, data);
+    float ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.f;
+    std::cout << "chunked total: " << ms << " ms " << count / (ms * 1000.f) << " Mkeys/s (" << sorter.ChunkSize() << " keys per chunk)" << std::endl;
+
+    std::sort(expected.begin(), expected.end());
+    for (size_t i = 0; i < count; i++) {
+        if (data[i] != expected[i]) {
+            std::cerr << "Sort failed: " << i << ": " << data[i] << " expected: " << expected[i] << std::endl;
+            exit(1);
+        }
+    }
+
+    sorter.Dispose();
+}
+
+// Sorts the uint2 records of inputPath into outputPath. Without paths a file of
+// a few chunks of random records is generated, sorted and checked.
+void TestExternalSort(const wgpu::Device& device, const char* inputPath, const char* outputPath) {
+    ExternalSort sorter;
+    sorter.Init(device, 1u << 22u);
+
+    std::vector<uint2> data;
+    std::string input = inputPath ? inputPath : "records.bin";
+    std::string output = outputPath ? outputPath : "records.sorted.bin";
+    if (!inputPath) {
+        // Few distinct keys, so equal keys span runs and the payloads check that
+        // ties go to the earlier run.
+        size_t count = size_t(sorter.ChunkSize()) * 5 + 12345;
+        std::vector<uint32_t> keys = ComputeUtil::fill_random_cpu(0, 1u << 16u, count, false);
+        data.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            data[i] = { keys[i], static_cast<uint32_t>(i) };
+        }
+
+        FILE* file = fopen(input.c_str(), "wb");
+        fwrite(data.data(), sizeof(uint2), count, file);
+        fclose(file);
+    }
+
+    auto start = high_resolution_clock::now();
+    sorter.SortFile(device, input, output);
+    float ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.f;
+    std::cout << "external total: " << ms << " ms" << std::endl;
+    sorter.Dispose();
+
+    if (inputPath) {
+        return;
+    }
+
+    std::vector<uint2> sorted(data.size());
+    FILE* file = fopen(output.c_str(), "rb");
+    size_t read = fread(sorted.data(), sizeof(uint2), sorted.size(), file);
+    fclose(file);
+
+    std::stable_sort(data.begin(), data.end(), [](const uint2& a, const uint2& b) { return a.x < b.x; });
+    for (size_t i = 0; i < data.size(); i++) {
+        if (read != data.size() || sorted[i].x != data[i].x || sorted[i].y != data[i].y) {
+            std::cerr << "Sort failed: " << i << ": " << sorted[i].x << "," << sorted[i].y
+                      << " expected: " << data[i].x << "," << data[i].y << std::endl;
+            exit(1);
+        }
+    }
+}
+
+// Streams batches through a SortPipeline and reports the steady-state throughput.
+// A few batches are generated up front and cycled so that the host side only
+// copies, every result is checked to be sorted within its segments.
+void TestSortPipeline(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device, uint32_t numSlots) {
+    using Record = SortElement<uint32_t, uint32_t>;
+    const uint32_t count = 1u << 21u;
+    const uint32_t numBatches = 64;
+    const uint32_t numInputs = 4;
+
+    std::vector<std::vector<Record>> inputs(numInputs);
+    std::vector<std::vector<uint32_t>> segments(numInputs);
+    for (uint32_t i = 0; i < numInputs; i++) {
+        inputs[i] = ComputeUtil::fill_random_records<uint32_t, uint32_t>(count);
+        segments[i] = ComputeUtil::fill_random_cpu(0u, count - 1, count / 100, true);
+    }
+
+    SortPipeline<uint32_t, uint32_t> pipeline;
+    pipeline.Init(instance, device, numSlots, count, count / 100,
+        [&](uint64_t batch, const void* data, uint32_t n) {
+            const Record* records = static_cast<const Record*>(data);
+            const std::vector<uint32_t>& heads = segments[batch % numInputs];
+            size_t seg = 0;
+            for (uint32_t i = 1; i < n; i++) {
+                while (seg < heads.size() && heads[seg] <= i) {
+                    seg++;
+                }
+                bool head = seg > 0 && heads[seg - 1] == i;
+                if (!head && records[i].key < records[i - 1].key) {
+                    std::cerr << "Sort failed: batch " << batch << " at " << i << std::endl;
+                    exit(1);
+                }
+            }
+        });
+
+    for (uint32_t batch = 0; batch < numBatches; batch++) {
+        pipeline.Push(inputs[batch % numInputs], segments[batch % numInputs]);
+    }
+    pipeline.Flush();
+
+    const SortPipelineStats& stats = pipeline.Stats();
+    std::cout << "pipeline (" << numSlots << " slots): " << stats.batches << " batches in " << stats.seconds * 1000.0 << " ms "
+              << stats.RecordsPerSecond() / 1e6 << " Mrecords/s" << std::endl;
+    pipeline.Dispose();
+}
+
+// Sorts ranges of a shared buffer and buffers of their own with one sorter. The
+// first round builds the bind groups of every range, the later rounds take them
+// from the cache.
+void TestSegsortBuffers(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    using Record = SortElement<uint32_t, uint32_t>;
+    const uint32_t count = 1u << 20u;
+    const uint32_t numSegments = count / 100;
+    const uint32_t numRanges = 6;
+    const uint32_t numShared = 4;
+    const int rounds = 3;
+
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+    uint64_t alignment = limits.limits.minStorageBufferOffsetAlignment;
+    uint64_t recordStride = (count * sizeof(Record) + alignment - 1) / alignment * alignment;
+    uint64_t segmentStride = (numSegments * sizeof(uint32_t) + alignment - 1) / alignment * alignment;
+
+    wgpu::Buffer sharedRecords = utils::CreateBuffer(device, numShared * recordStride, copyAllUsage, "SharedRecords");
+    wgpu::Buffer sharedSegments = utils::CreateBuffer(device, numShared * segmentStride, copyDstUsage, "SharedSegments");
+
+    std::vector<SortBufferRange> records(numRanges);
+    std::vector<SortBufferRange> segments(numRanges);
+    for (uint32_t i = 0; i < numRanges; i++) {
+        if (i < numShared) {
+            records[i] = SortBufferRange(sharedRecords, i * recordStride, count * sizeof(Record));
+            segments[i] = SortBufferRange(sharedSegments, i * segmentStride, numSegments * sizeof(uint32_t));
+        } else {
+            records[i] = utils::CreateBuffer(device, count * sizeof(Record), copyAllUsage, "Records");
+            segments[i] = utils::CreateBuffer(device, numSegments * sizeof(uint32_t), copyDstUsage, "Segments");
+        }
+    }
+
+    SegmentedSort<uint32_t, uint32_t> sorter;
+    sorter.Init(device, records[numShared].buffer, count, segments[numShared].buffer, numSegments);
+    if (!sorter.Upload(device, count, numSegments)) {
+        std::cerr << "TestSegsortBuffers: " << count << " records do not fit the device" << std::endl;
+        exit(1);
+    }
+
+    std::vector<std::vector<Record>> inputs(numRanges);
+    std::vector<std::vector<uint32_t>> heads(numRanges);
+    for (int round = 0; round < rounds; round++) {
+        for (uint32_t i = 0; i < numRanges; i++) {
+            inputs[i] = ComputeUtil::fill_random_records<uint32_t, uint32_t>(count);
+            heads[i] = ComputeUtil::fill_random_cpu(0u, count - 1, numSegments, true);
+            device.GetQueue().WriteBuffer(records[i].buffer, records[i].offset, inputs[i].data(), count * sizeof(Record));
+            device.GetQueue().WriteBuffer(segments[i].buffer, segments[i].offset, heads[i].data(), numSegments * sizeof(uint32_t));
+        }
+
+        auto start = high_resolution_clock::now();
+        wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+        for (uint32_t i = 0; i < numRanges; i++) {
+            sorter.Sort(encoder, wgpu::QuerySet(), records[i], segments[i], count, numSegments);
+        }
+        auto encoded = high_resolution_clock::now();
+        auto commandBuffer = encoder.Finish();
+        device.GetQueue().Submit(1, &commandBuffer);
+        ComputeUtil::BusyWaitDevice(instance, device);
+        auto end = high_resolution_clock::now();
+
+        std::cout << "segsort-buffers round " << round << ": encode " << duration_cast<microseconds>(encoded - start).count()
+                  << " us, total " << duration_cast<microseconds>(end - start).count() / 1000.f << " ms" << std::endl;
+    }
+
+    auto cmp = [](const Record& a, const Record& b) { return a.key < b.key; };
+    for (uint32_t i = 0; i < numRanges; i++) {
+        MappedRange mapped = readback->Map(records[i].buffer, count * sizeof(Record), records[i].offset).get();
+        if (!mapped) {
+            std::cerr << "TestSegsortBuffers: failed to map range " << i << std::endl;
+            exit(1);
+        }
+        std::span<const Record> output = mapped.As<Record>();
+
+        std::vector<Record> expected = inputs[i];
+        uint32_t cur = 0;
+        for (uint32_t head : heads[i]) {
+            std::sort(expected.begin() + cur, expected.begin() + head, cmp);
+            cur = head;
+        }
+        std::sort(expected.begin() + cur, expected.end(), cmp);
+
+        for (uint32_t j = 0; j < count; j++) {
+            if (output[j].key != expected[j].key) {
+                std::cerr << "Sort failed: range " << i << " at " << j << ": " << output[j].key << " expected: " << expected[j].key << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    sorter.Dispose();
+    for (uint32_t i = numShared; i < numRanges; i++) {
+        records[i].buffer.Destroy();
+        segments[i].buffer.Destroy();
+    }
+    sharedRecords.Destroy();
+    sharedSegments.Destroy();
+}
+
+// Sorts many small arrays in one submission through a BatchedSort. Every other
+// array is copied to a destination buffer in reverse order of the batch, the
+// keys are checked against std::sort of each array.
+void TestBatchedSort(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    using Record = SortElement<uint32_t, uint32_t>;
+    const uint32_t numArrays = 4096;
+
+    std::vector<std::vector<Record>> arrays(numArrays);
+    std::vector<uint32_t> lengths = ComputeUtil::fill_random_cpu(1u, 2048u, numArrays);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < numArrays; i++) {
+        arrays[i] = ComputeUtil::fill_random_records<uint32_t, uint32_t>(lengths[i]);
+        total += lengths[i];
+    }
+
+    wgpu::Buffer destination = utils::CreateBuffer(device, total * sizeof(Record), wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::CopySrc, "destination");
+    std::vector<uint64_t> destinationOffsets(numArrays);
+
+    BatchedSort<uint32_t, uint32_t> sorter;
+    sorter.Init(device, 1u << 20u, numArrays);
+
+    uint64_t offset = total * sizeof(Record);
+    for (uint32_t i = 0; i < numArrays; i++) {
+        if (i % 2 == 1) {
+            offset -= arrays[i].size() * sizeof(Record);
+            destinationOffsets[i] = offset;
+            sorter.Add(arrays[i], {}, destination, offset);
+        } else {
+            sorter.Add(arrays[i]);
+        }
+    }
+
+    auto start = high_resolution_clock::now();
+    wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+    sorter.Sort(device, encoder, wgpu::QuerySet());
+    auto commandBuffer = encoder.Finish();
+    device.GetQueue().Submit(1, &commandBuffer);
+    ComputeUtil::BusyWaitDevice(instance, device);
+    float ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.f;
+
+    MappedRange results = readback->Map(sorter.ResultBuffer(), sorter.GetRange(numArrays - 1).offset * sizeof(Record) + arrays.back().size() * sizeof(Record)).get();
+    MappedRange copies = readback->Map(destination, total * sizeof(Record)).get();
+    if (!results || !copies) {
+        std::cerr << "TestBatchedSort: failed to map the sorted arrays" << std::endl;
+        exit(1);
+    }
+    std::span<const Record> packed = results.As<Record>();
+    std::span<const Record> copied = copies.As<Record>();
+
+    auto cmp = [](const Record& a, const Record& b) { return a.key < b.key; };
+    for (uint32_t i = 0; i < numArrays; i++) {
+        std::vector<Record> expected = arrays[i];
+        std::sort(expected.begin(), expected.end(), cmp);
+
+        BatchedSortBase::Range range = sorter.GetRange(i);
+        const Record* sorted = i % 2 == 1 ? &copied[destinationOffsets[i] / sizeof(Record)] : &packed[range.offset];
+        for (uint32_t j = 0; j < range.count; j++) {
+            if (sorted[j].key != expected[j].key) {
+                std::cerr << "Sort failed: array " << i << " at " << j << ": " << sorted[j].key << " expected: " << expected[j].key << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    std::cout << "batched: " << numArrays << " arrays, " << total << " records in " << ms << " ms" << std::endl;
+    sorter.Dispose();
+    destination.Destroy();
+}
+
+// Creates the pipelines of the common sorters and returns the milliseconds it took.
+float TimeSorterInit(const wgpu::Device& device) {
+    const uint32_t count = 1u << 20u;
+    wgpu::Buffer keys = utils::CreateBuffer(device, count * sizeof(uint32_t), copyAllUsage, "Keys");
+    wgpu::Buffer records = utils::CreateBuffer(device, count * sizeof(uint64_t) * 2, copyAllUsage, "Records");
+    wgpu::Buffer segments = utils::CreateBuffer(device, count / 100 * sizeof(uint32_t), copyDstUsage, "Segments");
+
+    auto start = high_resolution_clock::now();
+    SubgroupSort subgroupSort;
+    subgroupSort.Init(device, keys, count);
+    RadixSort radixSort;
+    radixSort.Init(device, keys, count);
+    SegmentedSort<uint32_t, uint32_t> segmentedSort;
+    segmentedSort.Init(device, records, count, segments, count / 100);
+    SegmentedSort<uint64_t, uint32_t> wideSort;
+    wideSort.Init(device, records, count, segments, count / 100);
+    float ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.f;
+
+    subgroupSort.Dispose();
+    radixSort.Dispose();
+    segmentedSort.Dispose();
+    wideSort.Dispose();
+    keys.Destroy();
+    records.Destroy();
+    segments.Destroy();
+    return ms;
+}
+
+// Pipeline creation on a device with an emptied cache and on a second device
+// that finds every shader in the cache. Separate devices do not share Dawn's in
+// memory pipeline cache, so the second one behaves like a restarted process.
+void TestPipelineCache(const wgpu::Adapter& adapter) {
+    pipelineCache->Clear();
+    wgpu::Device cold = NativeUtils::SetupDevice(instance, adapter, pipelineCache.get());
+    float coldMs = TimeSorterInit(cold);
+    PipelineLibrary::Release(cold);
+    cold.Destroy();
+    PipelineCacheStats stored = pipelineCache->Stats();
+
+    wgpu::Device warm = NativeUtils::SetupDevice(instance, adapter, pipelineCache.get());
+    float warmMs = TimeSorterInit(warm);
+    PipelineLibrary::Release(warm);
+    warm.Destroy();
+    PipelineCacheStats loaded = pipelineCache->Stats();
+
+    std::cout << "pipeline cache " << pipelineCache->Directory() << std::endl;
+    std::cout << "  cold: " << coldMs << " ms, " << stored.stores << " entries stored (" << stored.bytesStored / 1024 << " KB)" << std::endl;
+    std::cout << "  warm: " << warmMs << " ms, " << loaded.hits - stored.hits << " hits, "
+              << loaded.misses - stored.misses << " misses (" << (loaded.bytesLoaded - stored.bytesLoaded) / 1024 << " KB)" << std::endl;
+}
+
+// Initializes sorters of four formats with Init, one after another, and then on
+// a fresh device with InitAsync, where all of them compile at once while the
+// host fills the input. No pipeline cache is attached, so both compile.
+void TestInitAsync(const wgpu::Adapter& adapter) {
+    const uint32_t count = 1u << 20u;
+    for (bool async : {false, true}) {
+        wgpu::Device device = NativeUtils::SetupDevice(instance, adapter);
+        wgpu::Buffer records = utils::CreateBuffer(device, count * sizeof(uint64_t) * 2, copyAllUsage, "Records");
+        wgpu::Buffer segments = utils::CreateBuffer(device, count / 100 * sizeof(uint32_t), copyDstUsage, "Segments");
+
+        SegmentedSort<uint32_t, uint32_t> a;
+        SegmentedSort<uint64_t, uint32_t> b;
+        SegmentedSort<float, uint32_t> c;
+        SegmentedSort<uint32_t, KeyOnly> d;
+
+        auto start = high_resolution_clock::now();
+        std::vector<std::future<void>> ready;
+        if (async) {
+            ready.push_back(a.InitAsync(device, records, count, segments, count / 100));
+            ready.push_back(b.InitAsync(device, records, count, segments, count / 100));
+            ready.push_back(c.InitAsync(device, records, count, segments, count / 100));
+            ready.push_back(d.InitAsync(device, records, count, segments, count / 100));
+        } else {
+            a.Init(device, records, count, segments, count / 100);
+            b.Init(device, records, count, segments, count / 100);
+            c.Init(device, records, count, segments, count / 100);
+            d.Init(device, records, count, segments, count / 100);
+        }
+        auto returned = high_resolution_clock::now();
+
+        // Work that overlaps the compile.
+        std::vector<SortElement<uint32_t, uint32_t>> input = ComputeUtil::fill_random_records<uint32_t, uint32_t>(count);
+        for (std::future<void>& future : ready) {
+            future.get();
+        }
+        auto end = high_resolution_clock::now();
+
+        std::cout << (async ? "InitAsync" : "Init") << ": returned after " << duration_cast<microseconds>(returned - start).count() / 1000.f
+                  << " ms, ready after " << duration_cast<microseconds>(end - start).count() / 1000.f << " ms" << std::endl;
+
+        a.Dispose();
+        b.Dispose();
+        c.Dispose();
+        d.Dispose();
+        records.Destroy();
+        segments.Destroy();
+        PipelineLibrary::Release(device);
+        device.Destroy();
+    }
+}
+
+// Initializes many sorters of a few formats on one device, as one sorter per
+// tenant and size class would. Only the first sorter of a format compiles, the
+// others take its pipelines from the device's PipelineLibrary.
+void TestPipelineLibrary(const wgpu::Adapter& adapter) {
+    const uint32_t count = 1u << 16u;
+    const uint32_t numSorters = 16;
+    wgpu::Device device = NativeUtils::SetupDevice(instance, adapter);
+
+    std::vector<wgpu::Buffer> buffers;
+    std::vector<std::unique_ptr<SegmentedSort<uint32_t, uint32_t>>> records;
+    std::vector<std::unique_ptr<SegmentedSort<float, KeyOnly>>> keys;
+    std::vector<std::unique_ptr<SubgroupSort>> subgroups;
+
+    for (uint32_t i = 0; i < numSorters; i++) {
+        wgpu::Buffer input = utils::CreateBuffer(device, count * sizeof(uint64_t), copyAllUsage, "Input");
+        wgpu::Buffer segments = utils::CreateBuffer(device, count / 100 * sizeof(uint32_t), copyDstUsage, "Segments");
+        buffers.push_back(input);
+        buffers.push_back(segments);
+
+        auto start = high_resolution_clock::now();
+        records.push_back(std::make_unique<SegmentedSort<uint32_t, uint32_t>>());
+        records.back()->Init(device, input, count, segments, count / 100);
+        keys.push_back(std::make_unique<SegmentedSort<float, KeyOnly>>());
+        keys.back()->Init(device, input, count, segments, count / 100);
+        subgroups.push_back(std::make_unique<SubgroupSort>());
+        subgroups.back()->Init(device, input, count);
+        float ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.f;
+
+        if (i < 2 || i + 1 == numSorters) {
+            std::cout << "sorters " << i << ": " << ms << " ms" << std::endl;
+        }
+    }
+
+    PipelineLibraryStats stats = PipelineLibrary::Get(device)->Stats();
+    std::cout << "pipeline library: " << stats.compiles << " compiled, " << stats.shared << " shared" << std::endl;
+
+    for (uint32_t i = 0; i < numSorters; i++) {
+        records[i]->Dispose();
+        keys[i]->Dispose();
+        subgroups[i]->Dispose();
+    }
+    for (wgpu::Buffer& buffer : buffers) {
+        buffer.Destroy();
+    }
+    PipelineLibrary::Release(device);
+    device.Destroy();
+}
+
+// Tunes the tile of a few formats on this adapter and stores them in the tile
+// profile, then sorts with the profiled tiles, which Init picks up.
+void TestAutotune(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    std::vector<SortFormat> formats = {
+        MakeSortFormat<uint32_t, uint32_t>(),
+        MakeSortFormat<uint32_t, KeyOnly>(),
+        MakeSortFormat<float, uint32_t>(),
+        MakeSortFormat<uint64_t, uint32_t>(),
+    };
+
+    for (const SortFormat& format : formats) {
+        std::vector<AutotuneResult> results;
+        SegmentedSortTile tile = AutotuneSegmentedSort(instance, device, format, AutotuneOptions(), &results);
+        for (const AutotuneResult& result : results) {
+            std::cout << "autotune " << format.Name() << " " << result.tile.nt << "x" << result.tile.vt << " nt2 " << result.tile.nt2
+                      << ": " << result.ms << " ms" << std::endl;
+        }
+
+        SegmentedSortTile fallback;
+        auto isDefault = [&](const AutotuneResult& r) { return r.tile.nt == fallback.nt && r.tile.vt == fallback.vt && r.tile.nt2 == fallback.nt2; };
+        auto defaultResult = std::find_if(results.begin(), results.end(), isDefault);
+        std::cout << format.Name() << ": " << tile.nt << "x" << tile.vt << " nt2 " << tile.nt2 << " " << results.front().ms << " ms";
+        if (defaultResult != results.end()) {
+            std::cout << ", default " << defaultResult->ms << " ms";
+        }
+        std::cout << std::endl;
+    }
+
+    TestSegsort<uint32_t, uint32_t>(instance, device);
+    TestSegsort<uint32_t, KeyOnly>(instance, device);
+    TestSegsort<float, uint32_t>(instance, device);
+    TestSegsort<uint64_t, uint32_t>(instance, device);
+}
+
+// Prints the tile each format derives from the device limits, then sorts the
+// widest and narrowest records with the tiles Init picks, which are these unless
+// the tile profile has an entry for the format.
+void TestLargestTile(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Device& device) {
+    wgpu::SupportedLimits limits;
+    device.GetLimits(&limits);
+
+    std::vector<SortFormat> formats = {
+        MakeSortFormat<uint32_t, KeyOnly>(),
+        MakeSortFormat<uint32_t, uint32_t>(),
+        MakeSortFormat<uint64_t, KeyOnly>(),
+        MakeSortFormat<uint64_t, uint32_t>(),
+    };
+    for (const SortFormat& format : formats) {
+        SegmentedSortTile tile = SegmentedSortBase::LargestTile(format, limits.limits);
+        std::cout << format.Name() << ": " << tile.nt << "x" << tile.vt << " = " << tile.nv() << " elements per tile" << std::endl;
+    }
+
+    TestSegsort<uint32_t, KeyOnly>(instance, device);
+    TestSegsort<uint64_t, uint32_t>(instance, device);
+}
+
+// Prints a tile kernel composed for the u32 record format and vt values per
+// thread, to inspect or validate a variant with an offline compiler. The thread
+// counts stay overridable constants.
+void PrintComposedKernel(const std::string& kernel, uint32_t vt) {
+    ShaderComposer composer;
+    composer.Define("VT", vt);
+    composer.Prelude(MakeSortFormat<uint32_t, uint32_t>().ShaderPrelude());
+
+    std::string source;
+    if (kernel == "block" || kernel == "block0") {
+        composer.Define("IN_PLACE", kernel == "block0" ? 1u : 0u);
+        composer.Prelude("  fn load_elem(i: u32) -> Elem { return keys_src.data[i]; }\n");
+        source =
+            #include "segsort_tuple/seg_block.wgsl"
+            ;
+    } else if (kernel == "merge") {
+        source =
+            #include "segsort_tuple/seg_merge.wgsl"
+            ;
+    } else if (kernel == "partition") {
+        source =
+            #include "segsort_tuple/seg_partition.wgsl"
+            ;
+    } else if (kernel == "copy") {
+        source =
+            #include "segsort_tuple/seg_copy.wgsl"
+            ;
+    } else {
+        std::cerr << "Unknown kernel: " << kernel << std::endl;
+        exit(1);
+    }
+    std::cout << composer.Compose(source, kernel);
+}
+
+int main(int argc, char** argv) {
+    std::string test = argc > 1 ? argv[1] : "subgroups";
+
     dawnProcSetProcs(&dawn::native::GetProcs());
 
     std::vector<const char*> enableToggleNames = {"allow_unsafe_apis", "dump_shaders"};
@@ -243,8 +972,82 @@ int main() {
     }
 
     wgpu::Adapter adapter = NativeUtils::SetupAdapter(instance);
-    wgpu::Device device = NativeUtils::SetupDevice(instance, adapter);
+    const char* cacheDirectory = std::getenv("PIPELINE_CACHE_DIR");
+    pipelineCache = std::make_unique<PipelineCache>(cacheDirectory ? cacheDirectory : ".pipeline_cache", adapter);
+    wgpu::Device device = NativeUtils::SetupDevice(instance, adapter, pipelineCache.get());
+    readback = std::make_unique<ReadbackPool>(instance, device);
 
-    TestSubgroups(instance, device);
+    if (test == "subgroups") {
+        TestKeySort<SubgroupSort>(instance, device, "subgroups");
+    } else if (test == "radix") {
+        TestKeySort<RadixSort>(instance, device, "radix");
+    } else if (test == "mergesort") {
+        TestKeySort<GlobalMergeSort>(instance, device, "mergesort");
+    } else if (test == "keys") {
+        TestKeySort<SubgroupSort>(instance, device, "subgroups");
+        TestKeySort<RadixSort>(instance, device, "radix");
+        TestKeySort<GlobalMergeSort>(instance, device, "mergesort");
+    } else if (test == "chunked") {
+        TestChunkedSort(device, 1u << 24u);
+    } else if (test == "largest-tile") {
+        TestLargestTile(instance, device);
+    } else if (test == "autotune") {
+        TestAutotune(instance, device);
+    } else if (test == "compose") {
+        PrintComposedKernel(argc > 2 ? argv[2] : "block", argc > 3 ? std::stoul(argv[3]) : 15);
+    } else if (test == "pipeline-library") {
+        TestPipelineLibrary(adapter);
+    } else if (test == "init-async") {
+        TestInitAsync(adapter);
+    } else if (test == "pipeline-cache") {
+        TestPipelineCache(adapter);
+    } else if (test == "sort-file") {
+        TestExternalSort(device, argc > 3 ? argv[2] : nullptr, argc > 3 ? argv[3] : nullptr);
+    } else if (test == "pipeline") {
+        TestSortPipeline(instance, device, 1);
+        TestSortPipeline(instance, device, 3);
+    } else if (test == "batched") {
+        TestBatchedSort(instance, device);
+    } else if (test == "segsort") {
+        TestSegsort<uint32_t, uint32_t>(instance, device);
+        TestSegsort<int32_t, uint32_t>(instance, device);
+        TestSegsort<float, uint32_t>(instance, device);
+        TestSegsort<uint64_t, uint32_t>(instance, device);
+    } else if (test == "segsort-keys") {
+        TestSegsort<uint32_t, KeyOnly>(instance, device);
+        TestSegsort<float, KeyOnly>(instance, device);
+        TestSegsort<uint64_t, KeyOnly>(instance, device);
+    } else if (test == "segsort-radix") {
+        TestSegsort<uint32_t, uint32_t>(instance, device, 200);
+        TestSegsort<float, uint32_t>(instance, device, 200);
+        TestSegsort<uint64_t, uint32_t>(instance, device, 200);
+        TestSegsort<uint32_t, KeyOnly>(instance, device, 200);
+        TestSegsortLeadingSegment(instance, device);
+    } else if (test == "segsort-desc") {
+        TestSegsort<uint32_t, uint32_t, std::greater<uint32_t>>(instance, device, 0, false, SortOrder::Descending);
+        TestSegsort<float, uint32_t, std::greater<float>>(instance, device, 0, false, SortOrder::Descending);
+        TestSegsort<uint64_t, KeyOnly, std::greater<uint64_t>>(instance, device, 0, false, SortOrder::Descending);
+        TestSegsort<int32_t, uint32_t, std::greater<int32_t>>(instance, device, 200, false, SortOrder::Descending);
+        TestSegsort<uint32_t, uint32_t, std::greater<uint32_t>>(instance, device, 0, true, SortOrder::Descending);
+        // A custom comparator, and one reversed again by the order.
+        TestSegsort<uint32_t, uint32_t, std::greater<uint32_t>>(instance, device, 0, false, SortOrder::Ascending, "b_key < a_key");
+        TestSegsort<float, KeyOnly, std::less<float>>(instance, device, 200, false, SortOrder::Descending, "b_key < a_key");
+    } else if (test == "segsort-buffers") {
+        TestSegsortBuffers(instance, device);
+    } else if (test == "argsort") {
+        TestArgsort<uint32_t>(instance, device);
+        TestArgsort<float>(instance, device);
+        TestArgsort<uint64_t>(instance, device);
+    } else if (test == "segsort-bucketed") {
+        // Short segments only, then the default mix that also has long ones.
+        TestSegsort<uint32_t, uint32_t>(instance, device, 1000, true);
+        TestSegsort<uint64_t, uint32_t>(instance, device, 1000, true);
+        TestSegsort<uint32_t, uint32_t>(instance, device, 0, true);
+        TestSegsort<uint32_t, KeyOnly>(instance, device, 0, true);
+    } else {
+        std::cerr << "Unknown test: " << test << std::endl;
+    }
+    readback.reset();
+    PipelineLibrary::Release(device);
     device.Destroy();
 }
\ No newline at end of file
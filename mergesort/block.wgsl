@@ -4,16 +4,25 @@ R"(
     count: u32,
     nt: u32,
     vt: u32,
-    coop: u32,
-    num_partition: u32,
+    merge_pass: u32,
+    num_partitions: u32,
   };
 
   struct Data { data: array<u32> };
-  // Needs to write since it may be used as both input and output
+#if IN_PLACE
+  // Sorts the tiles in place, used when the merge passes end in the input buffer.
   @binding(0) @group(0) var<storage, read_write> keys: Data;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+
+  fn store_key(i: u32, key: u32) { keys.data[i] = key; }
+#else
+  @binding(0) @group(0) var<storage, read> keys: Data;
   @binding(1) @group(0) var<storage, read_write> keys_out: Data;
   @binding(2) @group(0) var<uniform> params: Parameters;
 
+  fn store_key(i: u32, key: u32) { keys_out.data[i] = key; }
+#endif
+
   // nt * vt (128 * 15)
   var<workgroup> shared_: array<u32, 2048>;
   var<private> local_keys: array<u32, 16>;
@@ -71,13 +80,13 @@ R"(
   fn reg_to_mem_strided(global_offset: u32, tid: u32, count: u32) {
     if (15u > 1u && count >= 128u * 15u) {
       for (var i = 0u; i < 15u; i = i + 1u) {
-        keys_out.data[global_offset + 128u*i+tid] = local_keys[i];
+        store_key(global_offset + 128u*i+tid, local_keys[i]);
       }
     } else {
       for (var i = 0u; i < 15u; i = i + 1u) {
         let j = 128u * i + tid;
         if(j < count) {
-          keys_out.data[global_offset + 128u*i+tid] = local_keys[i];
+          store_key(global_offset + 128u*i+tid, local_keys[i]);
         }
       }   
     }
@@ -272,11 +281,15 @@ R"(
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
-    @builtin(global_invocation_id) global_id: vec3<u32>
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
     // SETUP
     let nv = 128u * 15u;
-    let tile = get_tile(workgroup_id.x, nv, params.count);
+    let cta = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (cta * nv >= params.count) {
+      return;
+    }
+    let tile = get_tile(cta, nv, params.count);
     let tile_count = tile.y - tile.x;
 
     // LOAD STUFF
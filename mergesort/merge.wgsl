@@ -3,18 +3,16 @@ R"(
     count: u32,
     nt: u32,
     vt: u32,
-    num_wg: u32,
-    num_partition: u32,
+    merge_pass: u32,
+    num_partitions: u32,
   };
 
   struct Data { data: array<u32> };
-  struct Counter { data: u32 };
 
   @binding(0) @group(0) var<storage, read> keys: Data;
   @binding(1) @group(0) var<storage, read_write> keys_out: Data;
   @binding(2) @group(0) var<uniform> params: Parameters;
-  @binding(3) @group(0) var<storage, read_write> partitions: Data;
-  @binding(4) @group(0) var<storage, read> counter: Counter;
+  @binding(3) @group(0) var<storage, read> partitions: Data;
 
   // nt * vt (128 * 15)
   var<workgroup> shared_: array<u32, 2048>;
@@ -243,22 +241,24 @@ R"(
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
-    @builtin(global_invocation_id) global_id: vec3<u32>
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
     // SETUP
     let nv = 128u * 15u;   
-    let pass_ = (counter.data / params.num_wg) - 1u;
-    let coop = 2 << pass_;
-    // let coop = params.coop;
+    let cta = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (cta * nv >= params.count) {
+      return;
+    }
+    let coop = 2 << params.merge_pass;
 
-    let tile = get_tile(workgroup_id.x, nv, params.count);
+    let tile = get_tile(cta, nv, params.count);
     let range = compute_mergesort_range_2(
       i32(params.count), 
-      i32(workgroup_id.x), 
+      i32(cta), 
       i32(coop), 
       i32(nv),
-      i32(partitions.data[workgroup_id.x]),
-      i32(partitions.data[workgroup_id.x + 1u])
+      i32(partitions.data[cta]),
+      i32(partitions.data[cta + 1u])
     );
 
     cta_merge_from_mem(range, local_id.x, workgroup_id);
@@ -3,17 +3,15 @@ R"(
     count: u32,
     nt: u32,
     vt: u32,
-    num_wg: u32,
+    merge_pass: u32,
     num_partitions: u32
   };
 
   struct Data { data: array<u32> };
-  struct Counter { data: atomic<u32> };
 
-  @binding(0) @group(0) var<storage, read_write> keys: Data;
+  @binding(0) @group(0) var<storage, read> keys: Data;
   @binding(1) @group(0) var<uniform> params: Parameters;
   @binding(2) @group(0) var<storage, read_write> partitions: Data;
-  @binding(3) @group(0) var<storage, read_write> counter: Counter;
 
   fn compute_mergesort_frame(partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
     let size = spacing * (coop / 2);
@@ -73,12 +71,7 @@ R"(
 
     let nv = 128u * 15u;    
 
-    let pass_ = atomicLoad(&counter.data) / params.num_wg;
-    let coop = 2 << pass_;
-
-    if (local_id.x == 0u) {
-      atomicAdd(&counter.data, 1u);
-    }
+    let coop = 2 << params.merge_pass;
 
     let spacing = i32(nv);
 
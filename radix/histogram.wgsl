@@ -0,0 +1,56 @@
+R"(
+  struct UniformData {
+    count: u32,
+    shift: u32,
+    pass_: u32,
+    num_tiles: u32,
+  }
+
+  @binding(0) @group(0) var<storage, read> keys: array<u32>;
+  @binding(1) @group(0) var<storage, read_write> histogram: array<atomic<u32>>;
+  @binding(2) @group(0) var<uniform> uniforms: UniformData;
+
+  const WG_SIZE = 256u;
+  const KEYS_PER_THREAD = 16u;
+  const RADIX = 256u;
+  const NUM_PASSES = 4u;
+
+  var<workgroup> local_hist: array<atomic<u32>, 1024>;
+
+  // Counts the digits of all four passes in a single read of the keys.
+  @compute @workgroup_size(WG_SIZE, 1, 1)
+  fn main(
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+    @builtin(num_workgroups) num_wgs: vec3<u32>
+  ) {
+    let base = (wg_id.y * num_wgs.x + wg_id.x) * WG_SIZE * KEYS_PER_THREAD;
+    if (base >= uniforms.count) {
+      return;
+    }
+
+    let tid = local_id.x;
+    for (var i = tid; i < NUM_PASSES * RADIX; i += WG_SIZE) {
+      atomicStore(&local_hist[i], 0u);
+    }
+    workgroupBarrier();
+
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = base + k * WG_SIZE + tid;
+      if (i < uniforms.count) {
+        let key = keys[i];
+        for (var p = 0u; p < NUM_PASSES; p++) {
+          atomicAdd(&local_hist[p * RADIX + ((key >> (8u * p)) & (RADIX - 1u))], 1u);
+        }
+      }
+    }
+    workgroupBarrier();
+
+    for (var i = tid; i < NUM_PASSES * RADIX; i += WG_SIZE) {
+      let c = atomicLoad(&local_hist[i]);
+      if (c != 0u) {
+        atomicAdd(&histogram[i], c);
+      }
+    }
+  }
+)"
@@ -0,0 +1,185 @@
+R"(
+  enable subgroups;
+
+  struct UniformData {
+    count: u32,
+    shift: u32,
+    pass_: u32,
+    num_tiles: u32,
+  }
+
+  @binding(0) @group(0) var<storage, read> keys_src: array<u32>;
+  @binding(1) @group(0) var<storage, read_write> keys_dst: array<u32>;
+  @binding(2) @group(0) var<storage, read> global_offsets: array<u32>;
+  @binding(3) @group(0) var<storage, read_write> status: array<atomic<u32>>;
+  @binding(4) @group(0) var<storage, read_write> tile_counters: array<atomic<u32>>;
+  @binding(5) @group(0) var<uniform> uniforms: UniformData;
+
+  const SG_SIZE = 32u;
+  const WG_SIZE = 256u;
+  const NUM_SG = WG_SIZE / SG_SIZE;
+  const KEYS_PER_THREAD = 8u;
+  const TILE_SIZE = WG_SIZE * KEYS_PER_THREAD;
+  const RADIX = 256u;
+
+  // Look-back status words hold a 29 bit count below a 3 bit flag. Even and odd
+  // passes use different flags, so whatever the previous pass left behind reads
+  // as not ready and the status buffer never needs to be cleared.
+  const VALUE_MASK = 0x1fffffffu;
+  const FLAG_SHIFT = 29u;
+
+  // Per subgroup digit counts, turned into per subgroup digit offsets.
+  var<workgroup> sg_hist: array<u32, NUM_SG * RADIX>;
+  // Leader ranks while ranking, the tile in digit order afterwards.
+  var<workgroup> tile_mem: array<u32, TILE_SIZE>;
+  var<workgroup> scan_mem: array<u32, 512>;
+  // Global position of a key minus its position in tile_mem, per digit.
+  var<workgroup> digit_shift: array<u32, RADIX>;
+  var<workgroup> tile_index: u32;
+
+  // One scatter pass of an LSD radix sort. Tiles are handed out in launch order
+  // through an atomic counter, ranked with subgroup ballots and placed with a
+  // decoupled look-back over the digit counts of the preceding tiles.
+  @compute @workgroup_size(WG_SIZE, 1, 1)
+  fn main(
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(subgroup_invocation_id) sg_id: u32
+  ) {
+    let tid = local_id.x;
+    if (tid == 0u) {
+      tile_index = atomicAdd(&tile_counters[uniforms.pass_], 1u);
+    }
+    for (var i = tid; i < NUM_SG * RADIX; i += WG_SIZE) {
+      sg_hist[i] = 0u;
+    }
+
+    let tile = workgroupUniformLoad(&tile_index);
+    if (tile >= uniforms.num_tiles) {
+      return;
+    }
+
+    let base = tile * TILE_SIZE;
+    let tile_count = min(TILE_SIZE, uniforms.count - base);
+    let sg = tid / SG_SIZE;
+    let lane_mask_lt = (1u << sg_id) - 1u;
+
+    var keys: array<u32, KEYS_PER_THREAD>;
+    var ranks: array<u32, KEYS_PER_THREAD>;
+
+    // Each subgroup ranks KEYS_PER_THREAD runs of 32 consecutive keys. Lanes with
+    // the same digit find each other with one ballot per digit bit, the lowest of
+    // them bumps the subgroup count and leaves the previous count in tile_mem.
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = (sg * KEYS_PER_THREAD + k) * SG_SIZE + sg_id;
+      let valid = i < tile_count;
+      var key = 0xffffffffu;
+      if (valid) {
+        key = keys_src[base + i];
+      }
+      keys[k] = key;
+      let digit = (key >> uniforms.shift) & (RADIX - 1u);
+
+      var peers = subgroupBallot2(valid)[0u];
+      if (!valid) {
+        peers = ~peers;
+      }
+      for (var bit = 0u; bit < 8u; bit++) {
+        let is_set = ((digit >> bit) & 1u) != 0u;
+        let ballot = subgroupBallot2(is_set)[0u];
+        if (is_set) {
+          peers &= ballot;
+        } else {
+          peers &= ~ballot;
+        }
+      }
+
+      let lower = countOneBits(peers & lane_mask_lt);
+      if (valid && lower == 0u) {
+        let h = sg * RADIX + digit;
+        tile_mem[i] = sg_hist[h];
+        sg_hist[h] += countOneBits(peers);
+      }
+      workgroupBarrier();
+
+      if (valid) {
+        ranks[k] = tile_mem[i - sg_id + firstTrailingBit(peers)] + lower;
+      }
+    }
+
+    // One thread per digit from here on: offsets of the subgroups within the digit
+    // and the tile total.
+    let digit = tid;
+    var total = 0u;
+    for (var s = 0u; s < NUM_SG; s++) {
+      let c = sg_hist[s * RADIX + digit];
+      sg_hist[s * RADIX + digit] = total;
+      total += c;
+    }
+
+    // Publish the aggregate before doing any more work so later tiles can move on.
+    let status_index = tile * RADIX + digit;
+    let odd = uniforms.pass_ & 1u;
+    let aggregate_flag = (1u + 2u * odd) << FLAG_SHIFT;
+    let prefix_flag = (2u + 2u * odd) << FLAG_SHIFT;
+    if (tile == 0u) {
+      atomicStore(&status[status_index], prefix_flag | total);
+    } else {
+      atomicStore(&status[status_index], aggregate_flag | total);
+    }
+
+    // Offsets of the digits within the tile.
+    var x = total;
+    var src = 0u;
+    scan_mem[tid] = x;
+    workgroupBarrier();
+    for (var offset = 1u; offset < RADIX; offset <<= 1u) {
+      if (tid >= offset) {
+        x += scan_mem[src + tid - offset];
+      }
+      src = RADIX - src;
+      scan_mem[src + tid] = x;
+      workgroupBarrier();
+    }
+    let local_offset = x - total;
+
+    // Walk back over the preceding tiles until one with a full prefix is found,
+    // spinning on tiles that have not published anything for this pass yet.
+    var exclusive = 0u;
+    if (tile > 0u) {
+      var lookback = tile - 1u;
+      loop {
+        let s = atomicLoad(&status[lookback * RADIX + digit]);
+        let flag = s & ~VALUE_MASK;
+        if (flag == prefix_flag) {
+          exclusive += s & VALUE_MASK;
+          break;
+        }
+        if (flag == aggregate_flag) {
+          exclusive += s & VALUE_MASK;
+          lookback -= 1u;
+        }
+      }
+      atomicStore(&status[status_index], prefix_flag | (exclusive + total));
+    }
+
+    digit_shift[digit] = global_offsets[uniforms.pass_ * RADIX + digit] + exclusive - local_offset;
+    scan_mem[digit] = local_offset;
+    workgroupBarrier();
+
+    // Sort the tile by digit in shared memory so that the global writes of a
+    // digit are contiguous.
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = (sg * KEYS_PER_THREAD + k) * SG_SIZE + sg_id;
+      if (i < tile_count) {
+        let d = (keys[k] >> uniforms.shift) & (RADIX - 1u);
+        tile_mem[scan_mem[d] + sg_hist[sg * RADIX + d] + ranks[k]] = keys[k];
+      }
+    }
+    workgroupBarrier();
+
+    for (var i = tid; i < tile_count; i += WG_SIZE) {
+      let key = tile_mem[i];
+      keys_dst[digit_shift[(key >> uniforms.shift) & (RADIX - 1u)] + i] = key;
+    }
+  }
+)"
@@ -0,0 +1,34 @@
+R"(
+  @binding(0) @group(0) var<storage, read_write> histogram: array<u32>;
+
+  const RADIX = 256u;
+  const NUM_PASSES = 4u;
+
+  var<workgroup> scan_mem: array<u32, 512>;
+
+  // Turns the digit counts of every pass into exclusive digit offsets, in place.
+  // Runs as a single workgroup with one thread per digit.
+  @compute @workgroup_size(RADIX, 1, 1)
+  fn main(@builtin(local_invocation_id) local_id: vec3<u32>) {
+    let tid = local_id.x;
+
+    for (var p = 0u; p < NUM_PASSES; p++) {
+      let count = histogram[p * RADIX + tid];
+      var x = count;
+      var src = 0u;
+      scan_mem[tid] = x;
+      workgroupBarrier();
+
+      for (var offset = 1u; offset < RADIX; offset <<= 1u) {
+        if (tid >= offset) {
+          x += scan_mem[src + tid - offset];
+        }
+        src = RADIX - src;
+        scan_mem[src + tid] = x;
+        workgroupBarrier();
+      }
+
+      histogram[p * RADIX + tid] = x - count;
+    }
+  }
+)"
@@ -8,9 +8,12 @@ R"(
     num_segments: u32,
     num_ranges: u32,
     num_partition_ctas: u32,
-    max_num_passes: u32
+    max_num_passes: u32,
+    partition_spacing: u32,
   };
 
+#import tile
+
   struct Data { data: array<u32> };
 
   @binding(0) @group(0) var<storage, read> segments: Data;
@@ -39,18 +42,19 @@ R"(
   }
 
  
-  @compute @workgroup_size(128, 1, 1)
+  @compute @workgroup_size(NT, 1, 1)
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
     @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
 
-    let nv = 128u * 15u;    
-    let spacing = nv;
+    let nv = NV;    
+    let spacing = params.partition_spacing;
 
-    let base = workgroup_id.x * nv;
-    for (var i = base + local_id.x; i < params.num_partitions; i = i + 128u) {
+    let base = (workgroup_id.y * num_workgroups.x + workgroup_id.x) * nv;
+    let end = min(base + nv, params.num_partitions);
+    for (var i = base + local_id.x; i < end; i = i + NT) {
       let key = min(spacing * i, params.count);
       partitions.data[i] = binary_search(params.num_segments, key);
     }
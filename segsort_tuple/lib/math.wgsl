@@ -0,0 +1,14 @@
+R"(
+  fn s_log2(x: u32) -> u32 {
+    if (x <= 1u) { return 0u; }
+
+    var v = x;
+    var c = 0u;
+    loop { 
+      v = v / 2u; 
+      if(v == 0u) { break; } 
+      c = c + 1u; 
+    }
+    return c;
+  }
+)"
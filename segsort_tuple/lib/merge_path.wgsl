@@ -0,0 +1,61 @@
+R"(
+  // Merge path search over two sorted runs. The importing kernel defines
+  // mp_elem(i), which reads element i of wherever the runs live.
+  fn merge_path_2(a_keys: i32, a_count: i32, b_keys: i32, b_count: i32, diag: i32) -> i32 {
+    var begin = max(0, diag - b_count);
+    var end   = min(diag, a_count);
+
+    loop {
+      if (begin >= end) {
+        break;
+      }
+      
+      let mid = u32(begin + end) / 2u;
+      let a_key = mp_elem(u32(a_keys) + mid);
+      let b_key = mp_elem(u32(b_keys) + u32(diag) - 1u - mid);
+
+      if (!comp(key_of(b_key), key_of(a_key))) {
+        begin = i32(mid + 1u);
+      } else {
+        end = i32(mid);
+      }
+    }
+
+    return begin;
+  }
+
+  fn merge_path(range: vec4<i32>, diag: i32) -> i32 {
+    return merge_path_2(
+      range.x, 
+      range.y - range.x, 
+      range.z, 
+      range.w - range.z,
+      diag 
+    );
+  }
+  
+  fn segmented_merge_path(range: vec4<i32>, active_: vec2<i32>, diag: i32) -> i32 {
+    // Consider a rectangle defined by range.
+    // Now consider a sub-rectangle at the top-right corner defined by
+    // active. We want to run the merge path only within this corner part.
+
+    // If the cross-diagonal does not intersect our corner, return immediately.
+    if (range.x + diag <= active_.x)  {
+      return diag;
+    }
+
+    if (range.x + diag >= active_.y) {
+      return range.y - range.x;
+    } 
+
+    // Call merge_path on the corner domain.
+    var cactive = active_;
+    cactive.x = max(cactive.x, range.x);
+    cactive.y = min(cactive.y, range.w);
+
+    let active_range = vec4<i32>(cactive.x, range.y, range.z, cactive.y);
+    let active_offset = cactive.x - range.x;
+    let p = merge_path(active_range, diag - active_offset);
+    return p + active_offset;
+  }
+)"
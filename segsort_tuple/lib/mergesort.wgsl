@@ -0,0 +1,28 @@
+R"(
+  fn partition_(range: vec4<i32>, mp0: i32, diag: i32) -> vec4<i32> {
+    return vec4<i32>(range.x + mp0, range.y, range.z + diag - mp0, range.w);
+  }
+
+  fn compute_mergesort_frame(partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
+    let size = spacing * (coop / 2);
+    let start = ~(coop - 1) & partition_;
+    let a_begin = spacing * start;
+    let b_begin = spacing * start + size;
+    return vec4<i32>(
+      a_begin,
+      a_begin + size,
+      b_begin,
+      b_begin + size
+    );
+  }
+
+  fn compute_mergesort_range(count: i32, partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
+    let frame = compute_mergesort_frame(partition_, coop, spacing);
+    return vec4<i32>(
+      frame.x,
+      min(count, frame.y),
+      min(count, frame.z),
+      min(count, frame.w)
+    );
+  }
+)"
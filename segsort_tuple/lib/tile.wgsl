@@ -0,0 +1,11 @@
+R"(
+  // Tile geometry of the variant: NT threads load VT elements each for a tile
+  // of NV elements, NT2 threads compute the merge partitions. NT and NT2 are
+  // set when the pipeline is created, so the loops over them are unrolled for
+  // each configuration. VT sizes the private key registers, which WGSL only
+  // allows for const sizes, so it is composed into the source.
+  override NT: u32;
+  override NT2: u32;
+  const VT = ${VT}u;
+  override NV: u32 = NT * VT;
+)"
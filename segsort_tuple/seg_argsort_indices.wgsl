@@ -0,0 +1,34 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data2 { data: array<Elem> };
+  struct Data { data: array<u32> };
+
+  @binding(0) @group(0) var<storage, read> elems: Data2;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read_write> indices: Data;
+
+  // Copies the index payload of the sorted elements into a plain u32 array.
+  @compute @workgroup_size(128, 1, 1)
+  fn main(
+    @builtin(workgroup_id) workgroup_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
+  ) {
+    let i = (workgroup_id.y * num_workgroups.x + workgroup_id.x) * 128u + local_id.x;
+    if (i < params.count) {
+      indices.data[i] = elems.data[i][INDEX_WORD];
+    }
+  }
+)"
@@ -11,11 +11,27 @@ R"(
     max_num_passes: u32
   };
 
-  const words_per_thread = 4u;
+#import tile
+#import math
+#import mergesort
+#import merge_path
 
-  struct Data2 { data: array<vec2<u32>> };
+  // Flag words read per thread, enough for VT flag bytes at any byte offset.
+  const words_per_thread = (VT + 3u) / 4u;
+
+  struct Data2 { data: array<Elem> };
   struct Data { data: array<u32> };
 
+#if IN_PLACE
+  // The first block pass sorts the tiles in place.
+  @binding(0) @group(0) var<storage, read_write> keys_src: Data2;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read> segments: Data;
+  @binding(3) @group(0) var<storage, read> partitions: Data;
+  @binding(4) @group(0) var<storage, read_write> compressedRanges: Data;
+
+  fn store_elem(i: u32, e: Elem) { keys_src.data[i] = e; }
+#else
   @binding(0) @group(0) var<storage, read> keys_src: Data2;
   @binding(1) @group(0) var<storage, read_write> keys_dst: Data2;
   @binding(2) @group(0) var<uniform> params: Parameters;
@@ -23,38 +39,26 @@ R"(
   @binding(4) @group(0) var<storage, read> partitions: Data;
   @binding(5) @group(0) var<storage, read_write> compressedRanges: Data;
 
-  // nt * vt (128 * 15) + 1
-  var<workgroup> shared_: array<vec2<u32>, 1921>;
-  var<workgroup> ranges: array<i32, 128>;
-  var<private> local_keys: array<vec2<u32>, 15>;
+  fn store_elem(i: u32, e: Elem) { keys_dst.data[i] = e; }
+#endif
 
-  fn s_log2(x: u32) -> u32 {
-    if (x <= 1u) { return 0u; }
+  // nt * vt + 1
+  var<workgroup> shared_: array<Elem, NV + 1u>;
+  var<workgroup> ranges: array<i32, NT>;
+  var<private> local_keys: array<Elem, VT>;
 
-    var v = x;
-    var c = 0u;
-    loop { 
-      v = v / 2u; 
-      if(v == 0u) { break; } 
-      c = c + 1u; 
-    }
-    return c;
-  }
-
-  fn comp(a_key: u32, b_key: u32) -> bool {
-    return a_key < b_key;
-  }
+  fn mp_elem(i: u32) -> Elem { return shared_[i]; }
 
   fn mem_to_reg_strided(global_offset: u32, tid: u32, count: u32) {
-    if (count >= 128u * 15u) {
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        local_keys[i] = keys_src.data[global_offset + 128u*i+tid];
+    if (count >= NV) {
+      for (var i = 0u; i < VT; i = i + 1u) {
+        local_keys[i] = load_elem(global_offset + NT*i+tid);
       }
     } else {
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+      for (var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         if(j < count) {
-          local_keys[i] = keys_src.data[global_offset + 128u*i+tid];
+          local_keys[i] = load_elem(global_offset + NT*i+tid);
         }
       }   
     }
@@ -89,12 +93,12 @@ R"(
   }
 
   fn reg_to_shared_strided(tid: u32) {
-    for(var i = 0u; i < 15u; i = i + 1u) { shared_[128u * i + tid] = local_keys[i]; }
+    for(var i = 0u; i < VT; i = i + 1u) { shared_[NT * i + tid] = local_keys[i]; }
   }
 
   fn shared_to_reg_thread(tid: u32) {
-    for (var i = 0u; i < 15u; i = i +1u) { 
-      local_keys[i] = shared_[15u * tid + i]; 
+    for (var i = 0u; i < VT; i = i +1u) { 
+      local_keys[i] = shared_[VT * tid + i]; 
     }
   }
 
@@ -108,29 +112,29 @@ R"(
   }
 
   fn reg_to_shared_thread(tid: u32) {
-    for(var i = 0u; i < 15u; i = i + 1u) {
-      shared_[15u*tid+i] = local_keys[i];
+    for(var i = 0u; i < VT; i = i + 1u) {
+      shared_[VT*tid+i] = local_keys[i];
     }
     workgroupBarrier();
   }
 
   fn shared_to_reg_strided(tid: u32) {
-    for(var i = 0u; i < 15u; i = i + 1u) {
-      local_keys[i] = shared_[128u * i + tid];
+    for(var i = 0u; i < VT; i = i + 1u) {
+      local_keys[i] = shared_[NT * i + tid];
     }
     workgroupBarrier();
   }
 
   fn reg_to_mem_strided(global_offset: u32, tid: u32, count: u32) {
-    if (count >= 128u * 15u) {
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        keys_dst.data[global_offset + 128u*i+tid] = local_keys[i];
+    if (count >= NV) {
+      for (var i = 0u; i < VT; i = i + 1u) {
+        store_elem(global_offset + NT*i+tid, local_keys[i]);
       }
     } else {
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+      for (var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         if (j < count) {
-          keys_dst.data[global_offset + j] = local_keys[i];
+          store_elem(global_offset + j, local_keys[i]);
         }
       }   
     }
@@ -160,9 +164,9 @@ R"(
   }
 
   fn odd_even_sort(flags: u32) {
-    for(var j = 0u; j < 15u; j = j + 1u) {
-      for (var i = 1u & j; i < 15u - 1u; i = i + 2u) {
-        if((0u == ((2u << i) & flags)) && comp(local_keys[i + 1u].x, local_keys[i].x)) {
+    for(var j = 0u; j < VT; j = j + 1u) {
+      for (var i = 1u & j; i < VT - 1u; i = i + 2u) {
+        if((0u == ((2u << i) & flags)) && comp(key_of(local_keys[i + 1u]), key_of(local_keys[i]))) {
           swap(i, i + 1u);
         }
       }
@@ -203,19 +207,19 @@ R"(
     let gid_count = count - gid;
 
     // Set the head flags for out-of-range keys.
-    var head_flags = out_of_range_flags(15u * tid, 15u, gid_count);
+    var head_flags = out_of_range_flags(VT * tid, VT, gid_count);
 
     if (mp1 > mp0) {
       // Clear the flag bytes, then loop through the indices and poke in
       // flag bytes.
       for (var i = 0u; i < words_per_thread; i = i + 1u) {
-        shared_[128u * i + tid].x = 0u;
+        shared_[NT * i + tid] = word_elem(0u);
       }
       workgroupBarrier();
 
      
       // Workaround for no union 8 bit shared storage
-      let mpl = (u32(mp1 - mp0) + 127u) / 128u;
+      let mpl = (u32(mp1 - mp0) + NT - 1u) / NT;
       let base = u32(mp0) + mpl * tid;
       var prev_val: u32 = 100000000u;
       if (base > 0u && base < mp1) {
@@ -243,7 +247,7 @@ R"(
         let flag_index = cur / 4u;
         // TODO: validate parenthesis
         let val = 1u << ((cur % 4u) * 8u); 
-        shared_[flag_index].x = shared_[flag_index].x | val;
+        shared_[flag_index] = word_elem(elem_word(shared_[flag_index]) | val);
         has_own = true;
         mp_count = mp_count + 1u;
         prev_val = cur;
@@ -252,13 +256,13 @@ R"(
       workgroupBarrier();
 
       // Combine all the head flags for this thread.
-      let first = 15u * tid;
+      let first = VT * tid;
       let offset = first / 4u;
-      var prev = shared_[offset].x;
+      var prev = elem_word(shared_[offset]);
       let mask = 0x3210u + 0x1111u * (3u & first);
 
       for(var i = 0u; i < words_per_thread; i = i + 1u) {
-        let next = shared_[offset + 1u + i].x;
+        let next = elem_word(shared_[offset + 1u + i]);
         let x = prmt(prev, next, mask);
         prev = next;
 
@@ -269,7 +273,7 @@ R"(
         if ((0x01000000u & x) != 0u){ head_flags = head_flags | (1u << (4u * i + 3u)); }
       }
 
-      head_flags = head_flags & ((1u << 15u) - 1u);
+      head_flags = head_flags & ((1u << VT) - 1u);
 
       workgroupBarrier();
     }
@@ -277,92 +281,6 @@ R"(
     return head_flags;
   }
   
-  fn partition_(range: vec4<i32>, mp0: i32, diag: i32) -> vec4<i32> {
-    return vec4<i32>(range.x + mp0, range.y, range.z + diag - mp0, range.w);
-  }
-
-  fn compute_mergesort_frame(partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
-    let size = spacing * (coop / 2);
-    let start = ~(coop - 1) & partition_;
-    let a_begin = spacing * start;
-    let b_begin = spacing * start + size;
-    return vec4<i32>(
-      a_begin,
-      a_begin + size,
-      b_begin,
-      b_begin + size
-    );
-  }
-
-  fn compute_mergesort_range(count: i32, partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
-    let frame = compute_mergesort_frame(partition_, coop, spacing);
-    return vec4<i32>(
-      frame.x,
-      min(count, frame.y),
-      min(count, frame.z),
-      min(count, frame.w)
-    );
-  }
-
-  fn merge_path_2(a_keys: i32, a_count: i32, b_keys: i32, b_count: i32, diag: i32) -> u32 {
-    var begin = max(0, diag - b_count);
-    var end   = min(diag, a_count);
-
-    loop {
-      if (begin >= end) {
-        break;
-      }
-      let mid = u32(begin + end) / 2u;
-      let a_key = shared_[u32(a_keys) + mid];
-      let b_key = shared_[u32(b_keys + diag) - 1u - mid];
-
-      if (!comp(b_key.x, a_key.x)) {
-        begin = i32(mid + 1u);
-      } else {
-        end = i32(mid);
-      }
-    }
-
-    return u32(begin);
-  }
-
-  fn merge_path(range: vec4<i32>, diag: i32) -> u32 {
-    return merge_path_2(
-      range.x, 
-      range.y - range.x, 
-      range.z, 
-      range.w - range.z,
-      diag 
-    );
-  }
-
-  fn segmented_merge_path(range: vec4<i32>, active_: vec2<i32>, diag: i32) -> i32 {
-    // Consider a rectangle defined by range.
-    // Now consider a sub-rectangle at the top-right corner defined by
-    // active. We want to run the merge path only within this corner part.
-
-    // If the cross-diagonal does not intersect our corner, return immediately.
-    if (range.x + diag <= active_.x)  {
-      return diag;
-    }
-
-    if (range.x + diag >= active_.y) {
-      return range.y - range.x;
-    } 
-
-    // Call merge_path on the corner domain.
-    var cactive = active_;
-    cactive.x = max(cactive.x, range.x);
-    cactive.y = min(cactive.y, range.w);
-
-    let active_range = vec4<i32>(cactive.x, range.y, range.z, cactive.y);
-
-    let active_offset = cactive.x - range.x;
-    let p = merge_path(active_range, diag - active_offset);
-
-    return i32(p) + active_offset;
-  }
-
   fn segmented_serial_merge(range: vec4<i32>, active_: vec2<i32>) {
     var crange = range;
     crange.w = min(active_.y, crange.w);
@@ -370,14 +288,14 @@ R"(
     var a_key = shared_[crange.x];
     var b_key = shared_[crange.z];
 
-    for(var i = 0u; i < 15u; i = i + 1u) {
+    for(var i = 0u; i < VT; i = i + 1u) {
       var p: bool;
       if (crange.x >= crange.y) {
         p = false;
       } else if (crange.z >= crange.w || crange.x < active_.x) {
         p = true;
       } else {
-        p = !comp(b_key.x, a_key.x);
+        p = !comp(key_of(b_key), key_of(a_key));
       }
 
       var index: u32 = u32(crange.x);
@@ -428,8 +346,8 @@ R"(
     // Store the data from thread order into shared memory.
     reg_to_shared_thread(tid);
     let coop = 2 << pass_;
-    let range = compute_mergesort_range(i32(count), i32(tid), i32(coop), i32(15u));
-    let diag = 15u * tid - u32(range.x);
+    let range = compute_mergesort_range(i32(count), i32(tid), i32(coop), i32(VT));
+    let diag = VT * tid - u32(range.x);
     let mp = segmented_merge_path(range, inner, i32(diag));
 
     // Run a segmented serial merge.
@@ -451,17 +369,17 @@ R"(
     // Record the first and last occurrences of head flags in this segment.
     var active_: vec2<i32>;
     if (head_flags != 0u) {
-      active_.x = i32(15u * tid) - 1 + i32(ffs(head_flags));
-      active_.y = i32(15u * tid) + 31 - i32(clz(head_flags));
+      active_.x = i32(VT * tid) - 1 + i32(ffs(head_flags));
+      active_.y = i32(VT * tid) + 31 - i32(clz(head_flags));
     } else {
-      active_.x = i32(15u * 128u);
+      active_.x = i32(NV);
       active_.y = -1;
     }
 
     ranges[tid] = i32( bfi(u32(active_.y), u32(active_.x), 16u, 16u) );
     workgroupBarrier();
 
-    let num_passes = s_log2(128u);
+    let num_passes = s_log2(NT);
     // Merge threads starting with a pair until all values are merged.
     for (var pass_ = 0u; pass_ < num_passes; pass_++) {
       active_ = merge_pass(tid, count, pass_, active_);
@@ -470,21 +388,72 @@ R"(
     return active_;
   }
 
-  @compute @workgroup_size(128, 1, 1)
+#if LONG_ONLY
+  var<workgroup> long_tile: atomic<u32>;
+  var<workgroup> long_tile_flag: u32;
+
+  // Whether a segment longer than BUCKET_LIMIT_2 overlaps the tile. The bucket
+  // kernels have already sorted all the other segments.
+  fn has_long_segment(tid: u32, tile: vec2<u32>, p: vec2<u32>) -> bool {
+    for (var s = p.x + tid; s <= p.y; s = s + NT) {
+      var begin = 0u;
+      if (s > 0u) {
+        begin = segments.data[s - 1u];
+      }
+      var end = params.count;
+      if (s < params.num_segments) {
+        end = segments.data[s];
+      }
+      if (end > begin + BUCKET_LIMIT_2 && end > tile.x && begin < tile.y) {
+        atomicOr(&long_tile, 1u);
+      }
+    }
+    workgroupBarrier();
+    if (tid == 0u) {
+      long_tile_flag = atomicLoad(&long_tile);
+    }
+    return workgroupUniformLoad(&long_tile_flag) != 0u;
+  }
+#endif
+
+  @compute @workgroup_size(NT, 1, 1)
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
-    @builtin(global_invocation_id) global_id: vec3<u32>
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
-    let nv = 15u * 128u;
-    let tile = get_tile(workgroup_id.x, nv, params.count);
+    let cta = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (cta >= params.num_ranges) {
+      return;
+    }
+
+    let nv = NV;
+    let tile = get_tile(cta, nv, params.count);
     let tile_count = tile.y - tile.x;
 
     let p = vec2<u32>(
-      partitions.data[workgroup_id.x], 
-      partitions.data[workgroup_id.x + 1u]
+      partitions.data[cta], 
+      partitions.data[cta + 1u]
     );
-    let head_flags = load(p, nv, local_id.x, workgroup_id.x, params.count);
+
+#if LONG_ONLY
+    // A tile of short segments only is already sorted. Its range claims heads
+    // at its first and last element, which keeps the merge passes from merging
+    // across its boundaries.
+    if (!has_long_segment(local_id.x, tile, p)) {
+#if !IN_PLACE
+      for (var i = local_id.x; i < tile_count; i = i + NT) {
+        store_elem(tile.x + i, load_elem(tile.x + i));
+      }
+#endif
+      if (local_id.x == 0u) {
+        compressedRanges.data[cta] = bfi(tile_count - 1u, 0u, 16u, 16u);
+      }
+      return;
+    }
+#endif
+
+    let head_flags = load(p, nv, local_id.x, cta, params.count);
     mem_to_reg_thread(tile.x, local_id.x, tile_count);
     let active_ = block_sort(local_id.x, tile_count, head_flags);
 
@@ -492,7 +461,7 @@ R"(
 
     // segmented partitioning kernels.
     if (local_id.x == 0u) {
-     compressedRanges.data[workgroup_id.x] = bfi(u32(active_.y), u32(active_.x), 16u, 16u);
+     compressedRanges.data[cta] = bfi(u32(active_.y), u32(active_.x), 16u, 16u);
     }
   }
 )"
\ No newline at end of file
@@ -0,0 +1,64 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data { data: array<u32> };
+  struct Counters { data: array<atomic<u32>> };
+
+  @binding(0) @group(0) var<storage, read> segments: Data;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read_write> counters: Counters;
+  @binding(3) @group(0) var<storage, read_write> lists: Data;
+
+  // Sorts segments into buckets by length. Buckets 0 to 2 get a list of their
+  // segments, bucket 3 (everything longer than BUCKET_LIMIT_2) is only counted
+  // and left to the merge path. Segments of 0 or 1 elements are already sorted.
+  @compute @workgroup_size(128, 1, 1)
+  fn main(
+    @builtin(workgroup_id) workgroup_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
+  ) {
+    let segment = (workgroup_id.y * num_workgroups.x + workgroup_id.x) * 128u + local_id.x;
+    if (segment > params.num_segments) {
+      return;
+    }
+
+    var begin = 0u;
+    if (segment > 0u) {
+      begin = segments.data[segment - 1u];
+    }
+    var end = params.count;
+    if (segment < params.num_segments) {
+      end = segments.data[segment];
+    }
+    if (end <= begin + 1u) {
+      return;
+    }
+
+    let length = end - begin;
+    var bucket = 3u;
+    if (length <= BUCKET_LIMIT_0) {
+      bucket = 0u;
+    } else if (length <= BUCKET_LIMIT_1) {
+      bucket = 1u;
+    } else if (length <= BUCKET_LIMIT_2) {
+      bucket = 2u;
+    }
+
+    let index = atomicAdd(&counters.data[bucket], 1u);
+    if (bucket < 3u) {
+      lists.data[bucket * (params.num_segments + 1u) + index] = segment;
+    }
+  }
+)"
@@ -0,0 +1,50 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+#import tile
+
+  struct Data { data: array<u32> };
+
+  @binding(0) @group(0) var<uniform> params: Parameters;
+  @binding(1) @group(0) var<storage, read_write> counters: Data;
+
+  // Writes the indirect dispatch arguments of workgroup count n at offset,
+  // folded into a 2D grid past the per-dimension limit.
+  fn write_args(n: u32, offset: u32) {
+    var x = n;
+    var y = 1u;
+    if (n > 65535u) {
+      y = (n + 65534u) / 65535u;
+      x = (n + y - 1u) / y;
+    }
+    counters.data[offset] = x;
+    counters.data[offset + 1u] = y;
+    counters.data[offset + 2u] = 1u;
+  }
+
+  // Turns the bucket counts into dispatch arguments. The merge path kernels only
+  // get workgroups when there is at least one segment in the last bucket.
+  @compute @workgroup_size(1, 1, 1)
+  fn main() {
+    write_args((counters.data[0] + 127u) / 128u, 4u);
+    write_args(counters.data[1], 7u);
+    write_args(counters.data[2], 10u);
+
+    let nv = NV;
+    let has_long = counters.data[3] > 0u;
+    write_args(select(0u, (params.num_partitions + nv - 1u) / nv, has_long), 13u);
+    write_args(select(0u, params.num_ranges, has_long), 16u);
+    write_args(select(0u, params.num_partition_ctas, has_long), 19u);
+  }
+)"
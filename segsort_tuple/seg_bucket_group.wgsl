@@ -0,0 +1,113 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data2 { data: array<Elem> };
+  struct Data { data: array<u32> };
+
+  @binding(0) @group(0) var<storage, read_write> keys: Data2;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read> segments: Data;
+  @binding(3) @group(0) var<storage, read> lists: Data;
+  @binding(4) @group(0) var<storage, read> counters: Data;
+
+  const WG_SIZE = 128u;
+
+  var<workgroup> elems: array<Elem, BUCKET_CAPACITY>;
+  // Position of every element in the segment. Slots past the end of the segment
+  // hold positions past its length.
+  var<workgroup> positions: array<u32, BUCKET_CAPACITY>;
+
+  // Orders by key and then by position, so equal keys keep their input order
+  // and the sort is stable. Slots past the end sort after every element.
+  fn greater(a: u32, b: u32, length: u32) -> bool {
+    let pa = positions[a];
+    let pb = positions[b];
+    if (pa >= length || pb >= length) {
+      return pa > pb;
+    }
+    if (comp(key_of(elems[b]), key_of(elems[a]))) {
+      return true;
+    }
+    if (comp(key_of(elems[a]), key_of(elems[b]))) {
+      return false;
+    }
+    return pa > pb;
+  }
+
+  // One workgroup per segment of bucket BUCKET, bitonic sorted in shared memory
+  // over the segment length rounded up to a power of two. Ties are broken on the
+  // position, which makes the result match the stable merge path.
+  @compute @workgroup_size(WG_SIZE, 1, 1)
+  fn main(
+    @builtin(workgroup_id) workgroup_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
+  ) {
+    let index = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (index >= counters.data[BUCKET]) {
+      return;
+    }
+
+    let segment = lists.data[BUCKET * (params.num_segments + 1u) + index];
+    var begin = 0u;
+    if (segment > 0u) {
+      begin = segments.data[segment - 1u];
+    }
+    var end = params.count;
+    if (segment < params.num_segments) {
+      end = segments.data[segment];
+    }
+    let length = end - begin;
+
+    var n = 2u;
+    loop {
+      if (n >= length) {
+        break;
+      }
+      n = n << 1u;
+    }
+
+    let tid = local_id.x;
+    for (var i = tid; i < n; i = i + WG_SIZE) {
+      if (i < length) {
+        elems[i] = keys.data[begin + i];
+      }
+      positions[i] = i;
+    }
+    workgroupBarrier();
+
+    for (var k = 2u; k <= n; k = k << 1u) {
+      for (var j = k >> 1u; j > 0u; j = j >> 1u) {
+        for (var t = tid; t < n / 2u; t = t + WG_SIZE) {
+          let i = 2u * j * (t / j) + (t % j);
+          let l = i + j;
+          let ascending = (i & k) == 0u;
+          if (greater(i, l, length) == ascending) {
+            let e = elems[i];
+            elems[i] = elems[l];
+            elems[l] = e;
+            let q = positions[i];
+            positions[i] = positions[l];
+            positions[l] = q;
+          }
+        }
+        workgroupBarrier();
+      }
+    }
+
+    for (var i = tid; i < length; i = i + WG_SIZE) {
+      keys.data[begin + i] = elems[i];
+    }
+  }
+)"
@@ -0,0 +1,70 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data2 { data: array<Elem> };
+  struct Data { data: array<u32> };
+
+  @binding(0) @group(0) var<storage, read_write> keys: Data2;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read> segments: Data;
+  @binding(3) @group(0) var<storage, read> lists: Data;
+  @binding(4) @group(0) var<storage, read> counters: Data;
+
+  var<private> local_keys: array<Elem, BUCKET_LIMIT_0>;
+
+  // One thread per segment of bucket 0, sorted with an insertion sort in registers.
+  @compute @workgroup_size(128, 1, 1)
+  fn main(
+    @builtin(workgroup_id) workgroup_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
+  ) {
+    let index = (workgroup_id.y * num_workgroups.x + workgroup_id.x) * 128u + local_id.x;
+    if (index >= counters.data[0]) {
+      return;
+    }
+
+    let segment = lists.data[index];
+    var begin = 0u;
+    if (segment > 0u) {
+      begin = segments.data[segment - 1u];
+    }
+    var end = params.count;
+    if (segment < params.num_segments) {
+      end = segments.data[segment];
+    }
+    let length = end - begin;
+
+    for (var i = 0u; i < length; i = i + 1u) {
+      local_keys[i] = keys.data[begin + i];
+    }
+
+    for (var i = 1u; i < length; i = i + 1u) {
+      let e = local_keys[i];
+      var p = i;
+      loop {
+        if (p == 0u || !comp(key_of(e), key_of(local_keys[p - 1u]))) {
+          break;
+        }
+        local_keys[p] = local_keys[p - 1u];
+        p = p - 1u;
+      }
+      local_keys[p] = e;
+    }
+
+    for (var i = 0u; i < length; i = i + 1u) {
+      keys.data[begin + i] = local_keys[i];
+    }
+  }
+)"
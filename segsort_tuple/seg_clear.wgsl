@@ -22,18 +22,17 @@ R"(
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
-    @builtin(global_invocation_id) global_id: vec3<u32>
+    @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
+    let idx = (workgroup_id.y * num_workgroups.x + workgroup_id.x) * 128u + local_id.x;
 
-    if (global_id.x == 0u) {
+    if (idx == 0u) {
         pass_counter.data = 0u;
-    }   
-
-    let idx = workgroup_id.x * 128u + local_id.x;
+    }
 
-    if (idx < params.max_num_passes * 24u) {
-        // 0 if divisible by 3, 1 otherwise
-        op_counters.data[idx] = ((idx % 3u) + 1u) / 2u;
+    // The merge and copy counts of every pass.
+    if (idx < params.max_num_passes * 2u) {
+        op_counters.data[idx] = 0u;
     }
   }
 )"
\ No newline at end of file
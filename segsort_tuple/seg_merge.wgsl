@@ -11,7 +11,11 @@ R"(
     max_num_passes: u32
   };
 
-  struct Data2 { data: array<vec2<u32>> };
+#import tile
+#import mergesort
+#import merge_path
+
+  struct Data2 { data: array<Elem> };
   struct Data { data: array<u32> };
   struct MergeRanges { data: array<vec4<i32>> };
   struct Counter { data: u32 };
@@ -22,21 +26,20 @@ R"(
   @binding(3) @group(0) var<storage, read> merge_list: MergeRanges;
   @binding(4) @group(0) var<storage, read> compressed_ranges: Data;
   @binding(5) @group(0) var<storage, read> pass_counter: Counter;
+  @binding(6) @group(0) var<storage, read> op_args: Data;
 
-  var<workgroup> shared_: array<vec2<u32>, 1921>;
-  var<private> local_keys: array<vec2<u32>, 15>;
+  var<workgroup> shared_: array<Elem, NV + 1u>;
+  var<private> local_keys: array<Elem, VT>;
 
-  fn comp(a_key: u32, b_key: u32) -> bool {
-    return a_key < b_key;
-  }
+  fn mp_elem(i: u32) -> Elem { return shared_[i]; }
 
   fn load_two_streams_reg(a: u32, a_count: u32, b: u32, b_count: u32, tid: u32) {
     let bb = b - a_count;
     let count = a_count + b_count;
-    if (count >= 128u * 15u) {
+    if (count >= NV) {
 
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+      for (var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         if(j >= a_count) {
           local_keys[i] = keys_src.data[bb + j];
         } else {
@@ -44,8 +47,8 @@ R"(
         }
       }
     } else {
-      for (var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+      for (var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         if(j < count) {
           if(j >= a_count) {
             local_keys[i] = keys_src.data[bb + j];
@@ -60,8 +63,8 @@ R"(
   }
 
   fn reg_to_shared_strided(tid: u32) {
-    for(var i = 0u; i < 15u; i = i + 1u) {
-      shared_[128u * i + tid] = local_keys[i];
+    for(var i = 0u; i < VT; i = i + 1u) {
+      shared_[NT * i + tid] = local_keys[i];
     }
     workgroupBarrier();
   }
@@ -82,68 +85,6 @@ R"(
   }
 
 
-  fn merge_path_2(a_keys: i32, a_count: i32, b_keys: i32, b_count: i32, diag: i32) -> i32 {
-    var begin = max(0, diag - b_count);
-    var end   = min(diag, a_count);
-
-    loop {
-      if (begin >= end) {
-        break;
-      }
-      
-      let mid = u32(begin + end) / 2u;
-      let a_key = shared_[u32(a_keys) + mid];
-      let b_key = shared_[u32(b_keys) + u32(diag) - 1u - mid];
-
-      if (!comp(b_key.x, a_key.x)) {
-        begin = i32(mid + 1u);
-      } else {
-        end = i32(mid);
-      }
-    }
-
-    return begin;
-  }
-
-  fn merge_path(range: vec4<i32>, diag: i32) -> i32 {
-    return merge_path_2(
-      range.x, 
-      range.y - range.x, 
-      range.z, 
-      range.w - range.z,
-      diag 
-    );
-  }
-  
-  fn segmented_merge_path(range: vec4<i32>, active_: vec2<i32>, diag: i32) -> vec3<i32> {
-    // Consider a rectangle defined by range.
-    // Now consider a sub-rectangle at the top-right corner defined by
-    // active. We want to run the merge path only within this corner part.
-
-    // If the cross-diagonal does not intersect our corner, return immediately.
-    if (range.x + diag <= active_.x)  {
-      return vec3<i32>(diag, active_.x, active_.y);
-    }
-
-    if (range.x + diag >= active_.y) {
-      return vec3<i32>(range.y - range.x, active_.x, active_.y);
-    } 
-
-    // Call merge_path on the corner domain.
-    var cactive = active_;
-    cactive.x = max(cactive.x, range.x);
-    cactive.y = min(cactive.y, range.w);
-
-    let active_range = vec4<i32>(cactive.x, range.y, range.z, cactive.y);
-    let active_offset = cactive.x - range.x;
-    let p = merge_path(active_range, diag - active_offset);
-    return vec3<i32>(p + active_offset, cactive.x, cactive.y);
-  }
-
-  fn partition_(range: vec4<i32>, mp0: i32, diag: i32) -> vec4<i32> {
-    return vec4<i32>(range.x + mp0, range.y, range.z + diag - mp0, range.w);
-  }
-
   fn segmented_serial_merge(range: vec4<i32>, active_: vec2<i32>) {
     var crange = range;
     crange.w = min(active_.y, crange.w);
@@ -151,14 +92,14 @@ R"(
     var a_key = shared_[crange.x];
     var b_key = shared_[crange.z];
 
-    for(var i = 0u; i < 15u; i = i + 1u) {
+    for(var i = 0u; i < VT; i = i + 1u) {
       var p: bool;
       if (crange.x >= crange.y) {
         p = false;
       } else if (crange.z >= crange.w || crange.x < active_.x) {
         p = true;
       } else {
-        p = !comp(b_key.x, a_key.x);
+        p = !comp(key_of(b_key), key_of(a_key));
       }
 
       var index: u32 = u32(crange.x);
@@ -180,20 +121,20 @@ R"(
   }
 
   fn reg_to_shared_thread(tid: u32) {
-    for(var i = 0u; i < 15u; i = i + 1u) {
-      shared_[15u*tid+i] = local_keys[i];
+    for(var i = 0u; i < VT; i = i + 1u) {
+      shared_[VT*tid+i] = local_keys[i];
     }
   }
 
   fn shared_to_mem(tid: u32, count: u32, first: u32) {
-    if (count <= 128u * 15u) {
-      for(var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+    if (count <= NV) {
+      for(var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         keys_dst.data[first + j] = shared_[j];
       }
     } else {
-      for(var i = 0u; i < 15u; i = i + 1u) {
-        let j = 128u * i + tid;
+      for(var i = 0u; i < VT; i = i + 1u) {
+        let j = NT * i + tid;
         if (j < count) {
           keys_dst.data[first + j] = shared_[j];
         }
@@ -201,16 +142,21 @@ R"(
     }
   }
 
-  @compute @workgroup_size(128, 1, 1)
+  @compute @workgroup_size(NT, 1, 1)
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
     @builtin(num_workgroups) num_workgroups: vec3<u32>,
     @builtin(global_invocation_id) global_id: vec3<u32>,
   ) {
+    // The grid is folded into 2D and may overshoot the number of merges.
+    let cta = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (cta >= op_args.data[6]) {
+      return;
+    }
+
     let pass_ = (pass_counter.data / params.num_partition_ctas) - 1u;
-    let nv = 15u * 128u;    
-    let cta = workgroup_id.x;
+    let nv = NV;    
     let tid = local_id.x;
 
     var range = merge_list.data[cta];
@@ -245,15 +191,15 @@ R"(
     } 
 
     let warp_size = 32u;
-    let warp_offset = 15u * (~(warp_size - 1u) & tid);
+    let warp_offset = VT * (~(warp_size - 1u) & tid);
     var sort_warp: bool;
     if (list_parity != 0u)  {
       sort_warp = i32(warp_offset) < active_.y;
     } else {
-      sort_warp = i32(warp_offset + 15u * warp_size) >= active_.x;
+      sort_warp = i32(warp_offset + VT * warp_size) >= active_.x;
     }  
     
-    for(var i = 0u; i < 15u; i = i + 1u) { local_keys[i] = vec2<u32>(0u); };
+    for(var i = 0u; i < VT; i = i + 1u) { local_keys[i] = Elem(); };
     let local_range = to_local(range);
     var mp = 0;
     var diag = 0u;
@@ -262,10 +208,8 @@ R"(
     workgroupBarrier();
 
     if (sort_warp) {
-      diag = 15u * tid;
-      let ret = segmented_merge_path(local_range, active_, i32(diag));
-      mp = ret.x;
-      //active_ = vec2<i32>(ret.y, ret.z);
+      diag = VT * tid;
+      mp = segmented_merge_path(local_range, active_, i32(diag));
       partitioned = partition_(local_range, i32(mp), i32(diag));
       segmented_serial_merge(partitioned, active_);
     }
@@ -0,0 +1,57 @@
+R"(
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data { data: array<u32> };
+  struct Counter { data: u32 };
+
+  @binding(0) @group(0) var<uniform> params: Parameters;
+  @binding(1) @group(0) var<storage, read> pass_counter: Counter;
+  @binding(2) @group(0) var<storage, read> op_counters: Data;
+  @binding(3) @group(0) var<storage, read_write> op_args: Data;
+
+  // Writes the indirect dispatch arguments of workgroup count n at offset,
+  // folded into a 2D grid past the per-dimension limit.
+  fn write_args(n: u32, offset: u32) {
+    var x = n;
+    var y = 1u;
+    if (n > 65535u) {
+      y = (n + 65534u) / 65535u;
+      x = (n + y - 1u) / y;
+    }
+    op_args.data[offset] = x;
+    op_args.data[offset + 1u] = y;
+    op_args.data[offset + 2u] = 1u;
+  }
+
+  // Turns the merge and copy counts of the pass the partition kernel just ran
+  // into dispatch arguments, followed by the counts themselves so the folded
+  // grids can drop their extra workgroups. A gated partition dispatch without
+  // workgroups leaves the pass counter behind, nothing gets merged then.
+  @compute @workgroup_size(1, 1, 1)
+  fn main() {
+    let passes_done = pass_counter.data / params.num_partition_ctas;
+    var merges = 0u;
+    var copies = 0u;
+    if (passes_done > 0u) {
+      let pass_ = passes_done - 1u;
+      merges = op_counters.data[pass_ * 2u];
+      copies = op_counters.data[pass_ * 2u + 1u];
+    }
+
+    write_args(merges, 0u);
+    write_args(copies, 3u);
+    op_args.data[6] = merges;
+    op_args.data[7] = copies;
+  }
+)"
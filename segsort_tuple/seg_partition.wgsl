@@ -11,9 +11,12 @@ R"(
     max_num_passes: u32,
   };
 
-  const COPY_STATUS_OFFSET = 8192u;
+#import tile
+#import math
+#import mergesort
+#import merge_path
 
-  struct Data2 { data: array<vec2<u32>> };
+  struct Data2 { data: array<Elem> };
   struct Data { data: array<u32> };
   struct AtomicData { data: array<atomic<i32>> };
   struct AtomicCounter { data: atomic<u32> };
@@ -28,37 +31,16 @@ R"(
   @binding(5) @group(0) var<storage, read_write> op_counters: AtomicData;
   @binding(6) @group(0) var<storage, read_write> merge_list_data: MergeRanges;
   @binding(7) @group(0) var<storage, read_write> copy_list_data: Data;
+  // Whether a tile was left in place by the previous pass, one word per tile.
+  @binding(8) @group(0) var<storage, read_write> copy_status: Data;
   
   // 2*nt needed by scan
-  var<workgroup> shared_: array<i32, 128>;
+  var<workgroup> shared_: array<i32, 2u * NT2>;
+  var<workgroup> pass_index: u32;
 
-  fn comp(a_key: u32, b_key: u32) -> bool {
-    return a_key < b_key;
-  }
-  
-  fn compute_mergesort_frame(partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
-    let size = spacing * (coop / 2);
-    let start = ~(coop - 1) & partition_;
-    let a_begin = spacing * start;
-    let b_begin = spacing * start + size;
-    return vec4<i32>(
-      a_begin,
-      a_begin + size,
-      b_begin,
-      b_begin + size
-    );
-  }
-
-  fn compute_mergesort_range(count: i32, partition_: i32, coop: i32, spacing: i32) -> vec4<i32> {
-    let frame = compute_mergesort_frame(partition_, coop, spacing);
-    return vec4<i32>(
-      frame.x,
-      min(count, frame.y),
-      min(count, frame.z),
-      min(count, frame.w)
-    );
-  }
+  fn mp_elem(i: u32) -> Elem { return keys.data[i]; }
 
+  
   fn compute_mergesort_range_2(count: i32, partition_: i32, coop: i32, spacing: i32, mp0: i32, mp1: i32) -> vec4<i32> {
     var range = compute_mergesort_range(count, partition_, coop, spacing);
     let diag = spacing * partition_ - range.x;
@@ -73,98 +55,25 @@ R"(
     return range;
   }
 
-  fn merge_path_2(a_keys: i32, a_count: i32, b_keys: i32, b_count: i32, diag: i32) -> i32 {
-    var begin = max(0, diag - b_count);
-    var end   = min(diag, a_count);
-
-    loop {
-      if (begin >= end) {
-        break;
-      }
-      
-      let mid = u32(begin + end) / 2u;
-      let a_key = keys.data[u32(a_keys) + mid];
-      let b_key = keys.data[u32(b_keys) + u32(diag) - 1u - mid];
-
-      if (!comp(b_key.x, a_key.x)) {
-        begin = i32(mid + 1u);
-      } else {
-        end = i32(mid);
-      }
-    }
-
-    return begin;
-  }
-
-  fn merge_path(range: vec4<i32>, diag: i32) -> i32 {
-    return merge_path_2(
-      range.x, 
-      range.y - range.x, 
-      range.z, 
-      range.w - range.z,
-      diag 
-    );
-  }
-  
-  fn segmented_merge_path(range: vec4<i32>, active_: vec2<i32>, diag: i32) -> i32 {
-    // Consider a rectangle defined by range.
-    // Now consider a sub-rectangle at the top-right corner defined by
-    // active. We want to run the merge path only within this corner part.
-
-    // If the cross-diagonal does not intersect our corner, return immediately.
-    if (range.x + diag <= active_.x)  {
-      return diag;
-    }
-
-    if (range.x + diag >= active_.y) {
-      return range.y - range.x;
-    } 
-
-    // Call merge_path on the corner domain.
-    var cactive = active_;
-    cactive.x = max(cactive.x, range.x);
-    cactive.y = min(cactive.y, range.w);
-
-    let active_range = vec4<i32>(cactive.x, range.y, range.z, cactive.y);
-    let active_offset = cactive.x - range.x;
-    let p = merge_path(active_range, diag - active_offset);
-    return p + active_offset;
-  }
-
-
-  fn s_log2(x: u32) -> u32 {
-    if (x <= 1u) { return 0u; }
-
-    var v = x;
-    var c = 0u;
-    loop { 
-      v = v / 2u; 
-      if(v == 0u) { break; } 
-      c = c + 1u; 
-    }
-    return c;
-  }
-
   fn scan(tid: u32, x: u32) -> vec2<i32> {
     var cx = i32(x);
     var first = 0u;
 
     shared_[first + tid] = cx;
     workgroupBarrier();
-    // s_log2(64u)
-    for(var i = 0u; i < 6u; i = i + 1u) {
+    for(var i = 0u; i < s_log2(NT2); i = i + 1u) {
       let offset = 1u << i;
       if (tid >= offset) {
         cx = cx + shared_[first + tid - offset];
       }
         
-      first = 64u - first;
+      first = NT2 - first;
       shared_[first + tid] = cx;
       workgroupBarrier();
     }
       
 
-    let count = 64u;
+    let count = NT2;
     var result: vec2<i32>;
     result.x = shared_[first + count - 1u];
     if (tid < count) {
@@ -195,31 +104,37 @@ R"(
   }
 
 
-  @compute @workgroup_size(64, 1, 1)
+  @compute @workgroup_size(NT2, 1, 1)
   fn main(
     @builtin(workgroup_id) workgroup_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
     @builtin(num_workgroups) num_workgroups: vec3<u32>
   ) {
+    // Workgroups past the partition ctas of a folded grid must not bump the pass
+    // counter, every pass derives its index from it.
+    let cta = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (cta >= params.num_partition_ctas) {
+      return;
+    }
 
-    let pass_ = atomicLoad(&pass_counter.data) / params.num_partition_ctas;
-    let coop = 2 << pass_;
-
+    // Only invocation 0 touches the counter. A load by the others could already
+    // see its increment and land in the next pass.
     if (local_id.x == 0u) {
-      atomicAdd(&pass_counter.data, 1u);
+      pass_index = atomicAdd(&pass_counter.data, 1u) / params.num_partition_ctas;
     }
+    let pass_ = workgroupUniformLoad(&pass_index);
+    let coop = 2 << pass_;
 
-    let nv = 128u * 15u;    
+    let nv = NV;    
     let spacing = nv;
-    let cta = workgroup_id.x;
     let tid = local_id.x;
 
-    let partition_ = (64u - 1u) * cta + tid;
+    let partition_ = (NT2 - 1u) * cta + tid;
     let first = nv * partition_;
     let count2 = min(nv, params.count - first);
 
     var mp0 = 0;
-    let active_ = (tid < 64u - 1u) && (partition_ < params.num_partitions - 1u);
+    let active_ = (tid < NT2 - 1u) && (partition_ < params.num_partitions - 1u);
     let range_index = partition_ >> pass_;
 
     if (partition_ < params.num_partitions) {
@@ -297,7 +212,7 @@ R"(
     if (active_) {
       let interval_count = u32(interval.y-interval.x);
       merge_op = (first != u32(interval.x)) || (interval_count != count2);
-      copy_op = !merge_op && (pass_ == 0u || copy_list_data.data[COPY_STATUS_OFFSET + partition_] == 0u);
+      copy_op = !merge_op && (pass_ == 0u || copy_status.data[partition_] == 0u);
 
       // Use the b_end component to store the index of the destination tile.
       // The actual b_end can be inferred from a_count and the length of 
@@ -309,13 +224,13 @@ R"(
     let copy_scan = scan(tid, u32(copy_op));
 
     if (tid == 0u) {
-      shared_[0] = atomicAdd(&op_counters.data[pass_*6u], i32(merge_scan.x));
-      shared_[1] = atomicAdd(&op_counters.data[(pass_*2u+1u) * 3u], i32(copy_scan.x));
+      shared_[0] = atomicAdd(&op_counters.data[pass_ * 2u], i32(merge_scan.x));
+      shared_[1] = atomicAdd(&op_counters.data[pass_ * 2u + 1u], i32(copy_scan.x));
     }
     workgroupBarrier();
 
     if (active_) {
-      copy_list_data.data[COPY_STATUS_OFFSET + partition_] = u32(!merge_op);
+      copy_status.data[partition_] = u32(!merge_op);
       if (merge_op) {
         merge_list_data.data[u32(shared_[0]) + u32(merge_scan.y)] = range;
       }
@@ -0,0 +1,233 @@
+R"(
+  enable subgroups;
+
+  struct Parameters {
+    count: u32,
+    nt: u32,
+    vt: u32,
+    nt2: u32,
+    num_partitions: u32,
+    num_segments: u32,
+    num_ranges: u32,
+    num_partition_ctas: u32,
+    max_num_passes: u32,
+    partition_spacing: u32,
+  };
+
+  struct Data2 { data: array<Elem> };
+  struct Data { data: array<u32> };
+
+  @binding(0) @group(0) var<storage, read_write> keys: Data2;
+  @binding(1) @group(0) var<uniform> params: Parameters;
+  @binding(2) @group(0) var<storage, read> segments: Data;
+  @binding(3) @group(0) var<storage, read> partitions: Data;
+
+  const SG_SIZE = 32u;
+  const WG_SIZE = 128u;
+  const NUM_SG = WG_SIZE / SG_SIZE;
+  const KEYS_PER_THREAD = 8u;
+  const CAPACITY = WG_SIZE * KEYS_PER_THREAD;
+  const RADIX = 256u;
+
+  // The tile and the local segment index of every element.
+  var<workgroup> elems: array<Elem, CAPACITY>;
+  var<workgroup> segs: array<u32, CAPACITY>;
+  // Leader ranks of the ballot ranking.
+  var<workgroup> leader_mem: array<u32, CAPACITY>;
+  // Per subgroup digit counts, turned into per subgroup digit offsets.
+  var<workgroup> sg_hist: array<u32, NUM_SG * RADIX>;
+  var<workgroup> digit_offsets: array<u32, RADIX>;
+  var<workgroup> scan_mem: array<u32, 256>;
+
+  // First element of the segments owned by window w: the segments that start
+  // within [w * spacing, (w + 1) * spacing).
+  fn window_begin(w: u32) -> u32 {
+    if (w == 0u) {
+      return 0u;
+    }
+    let p = partitions.data[w];
+    if (p >= params.num_segments) {
+      return params.count;
+    }
+    return segments.data[p];
+  }
+
+  // Number of segment heads in [segments[first], segments[end]) at or before pos.
+  fn upper_bound(first: u32, end: u32, pos: u32) -> u32 {
+    var begin = first;
+    var last = end;
+    loop {
+      if (begin >= last) {
+        break;
+      }
+      let mid = (begin + last) / 2u;
+      if (segments.data[mid] <= pos) {
+        begin = mid + 1u;
+      } else {
+        last = mid;
+      }
+    }
+    return begin - first;
+  }
+
+  // Key digits come first, least significant first, the local segment index last
+  // so that the final order is by segment and then by key.
+  fn digit_of(e: Elem, seg: u32, pass_: u32) -> u32 {
+    if (pass_ < 4u * KEY_WORDS) {
+      return (radix_word(key_of(e), pass_ / 4u) >> (8u * (pass_ % 4u))) & (RADIX - 1u);
+    }
+    return (seg >> (8u * (pass_ - 4u * KEY_WORDS))) & (RADIX - 1u);
+  }
+
+  // One stable counting sort pass over the tile in shared memory. Ranks come from
+  // subgroup ballots like in the onesweep radix sort, every subgroup owns
+  // KEYS_PER_THREAD runs of 32 consecutive elements.
+  fn sort_pass(tid: u32, sg_id: u32, count: u32, pass_: u32) {
+    let sg = tid / SG_SIZE;
+    let lane_mask_lt = (1u << sg_id) - 1u;
+
+    for (var i = tid; i < NUM_SG * RADIX; i += WG_SIZE) {
+      sg_hist[i] = 0u;
+    }
+    workgroupBarrier();
+
+    var local_elems: array<Elem, KEYS_PER_THREAD>;
+    var local_segs: array<u32, KEYS_PER_THREAD>;
+    var digits: array<u32, KEYS_PER_THREAD>;
+    var ranks: array<u32, KEYS_PER_THREAD>;
+
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = (sg * KEYS_PER_THREAD + k) * SG_SIZE + sg_id;
+      let valid = i < count;
+      var digit = 0u;
+      if (valid) {
+        local_elems[k] = elems[i];
+        local_segs[k] = segs[i];
+        digit = digit_of(local_elems[k], local_segs[k], pass_);
+      }
+      digits[k] = digit;
+
+      var peers = subgroupBallot2(valid)[0u];
+      if (!valid) {
+        peers = ~peers;
+      }
+      for (var bit = 0u; bit < 8u; bit++) {
+        let is_set = ((digit >> bit) & 1u) != 0u;
+        let ballot = subgroupBallot2(is_set)[0u];
+        if (is_set) {
+          peers &= ballot;
+        } else {
+          peers &= ~ballot;
+        }
+      }
+
+      let lower = countOneBits(peers & lane_mask_lt);
+      if (valid && lower == 0u) {
+        let h = sg * RADIX + digit;
+        leader_mem[i] = sg_hist[h];
+        sg_hist[h] += countOneBits(peers);
+      }
+      workgroupBarrier();
+
+      if (valid) {
+        ranks[k] = leader_mem[i - sg_id + firstTrailingBit(peers)] + lower;
+      }
+    }
+
+    // Every thread owns two neighbouring digits.
+    var thread_total = 0u;
+    for (var j = 0u; j < 2u; j++) {
+      let d = 2u * tid + j;
+      var total = 0u;
+      for (var s = 0u; s < NUM_SG; s++) {
+        let c = sg_hist[s * RADIX + d];
+        sg_hist[s * RADIX + d] = total;
+        total += c;
+      }
+      digit_offsets[d] = thread_total;
+      thread_total += total;
+    }
+
+    var x = thread_total;
+    var src = 0u;
+    scan_mem[tid] = x;
+    workgroupBarrier();
+    for (var offset = 1u; offset < WG_SIZE; offset <<= 1u) {
+      if (tid >= offset) {
+        x += scan_mem[src + tid - offset];
+      }
+      src = WG_SIZE - src;
+      scan_mem[src + tid] = x;
+      workgroupBarrier();
+    }
+    digit_offsets[2u * tid] += x - thread_total;
+    digit_offsets[2u * tid + 1u] += x - thread_total;
+    workgroupBarrier();
+
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = (sg * KEYS_PER_THREAD + k) * SG_SIZE + sg_id;
+      if (i < count) {
+        let d = digits[k];
+        let dst = digit_offsets[d] + sg_hist[sg * RADIX + d] + ranks[k];
+        elems[dst] = local_elems[k];
+        segs[dst] = local_segs[k];
+      }
+    }
+    workgroupBarrier();
+  }
+
+  // Sorts all segments owned by a window in shared memory. Windows are
+  // partition_spacing apart and CAPACITY is at least partition_spacing plus the
+  // longest segment, so every segment is sorted by exactly one workgroup and no
+  // merge passes are needed.
+  @compute @workgroup_size(WG_SIZE, 1, 1)
+  fn main(
+    @builtin(workgroup_id) workgroup_id: vec3<u32>,
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(num_workgroups) num_workgroups: vec3<u32>,
+    @builtin(subgroup_invocation_id) sg_id: u32
+  ) {
+    let w = workgroup_id.y * num_workgroups.x + workgroup_id.x;
+    if (w >= params.num_ranges) {
+      return;
+    }
+
+    let begin = window_begin(w);
+    let count = min(window_begin(w + 1u) - begin, CAPACITY);
+    if (count <= 1u) {
+      return;
+    }
+
+    // Segment heads within the window.
+    var first_head = 0u;
+    if (w > 0u) {
+      first_head = partitions.data[w];
+    }
+    let end_head = partitions.data[w + 1u];
+    let num_heads = end_head - first_head;
+
+    let tid = local_id.x;
+    for (var i = tid; i < count; i += WG_SIZE) {
+      elems[i] = keys.data[begin + i];
+      segs[i] = upper_bound(first_head, end_head, begin + i);
+    }
+    workgroupBarrier();
+
+    // Skip the segment passes when the window holds a single segment. Elements
+    // of window 0 before its first listed head form an extra segment with
+    // local index 0.
+    let num_local_segments = num_heads + select(0u, 1u, w == 0u);
+    var seg_passes = 0u;
+    if (num_local_segments > 1u) {
+      seg_passes = (firstLeadingBit(num_heads) + 8u) / 8u;
+    }
+
+    for (var pass_ = 0u; pass_ < 4u * KEY_WORDS + seg_passes; pass_++) {
+      sort_pass(tid, sg_id, count, pass_);
+    }
+
+    for (var i = tid; i < count; i += WG_SIZE) {
+      keys.data[begin + i] = elems[i];
+    }
+  }
+)"
@@ -0,0 +1,79 @@
+R"(
+  struct UniformData {
+    count: u32,
+    width: u32,
+  }
+
+  @binding(0) @group(0) var<storage, read> keys_src: array<u32>;
+  @binding(1) @group(0) var<storage, read_write> keys_dst: array<u32>;
+  @binding(2) @group(0) var<uniform> uniforms: UniformData;
+
+  const WG_SIZE = 256u;
+  const VT = 8u;
+
+  fn merge_path(a_begin: u32, a_count: u32, b_begin: u32, b_count: u32, diag: u32) -> u32 {
+    var begin = select(0u, diag - b_count, diag > b_count);
+    var end = min(diag, a_count);
+
+    loop {
+      if (begin >= end) {
+        break;
+      }
+      let mid = (begin + end) / 2u;
+      let a_key = keys_src[a_begin + mid];
+      let b_key = keys_src[b_begin + diag - 1u - mid];
+      if (!(b_key < a_key)) {
+        begin = mid + 1u;
+      } else {
+        end = mid;
+      }
+    }
+    return begin;
+  }
+
+  // Merges pairs of sorted runs of uniforms.width keys. Every thread finds its
+  // starting point with a merge path search and then merges VT keys serially.
+  @compute @workgroup_size(WG_SIZE, 1, 1)
+  fn main(
+    @builtin(local_invocation_id) local_id: vec3<u32>,
+    @builtin(workgroup_id) wg_id: vec3<u32>,
+    @builtin(num_workgroups) num_wgs: vec3<u32>
+  ) {
+    let count = uniforms.count;
+    let width = uniforms.width;
+    let first = ((wg_id.y * num_wgs.x + wg_id.x) * WG_SIZE + local_id.x) * VT;
+    if (first >= count) {
+      return;
+    }
+
+    let frame = (first / (2u * width)) * (2u * width);
+    let a_begin = frame;
+    let a_end = min(frame + width, count);
+    let b_begin = a_end;
+    let b_end = min(b_begin + width, count);
+
+    let diag = first - frame;
+    let mp = merge_path(a_begin, a_end - a_begin, b_begin, b_end - b_begin, diag);
+
+    var a = a_begin + mp;
+    var b = b_begin + diag - mp;
+    var a_key = 0u;
+    var b_key = 0u;
+    if (a < a_end) { a_key = keys_src[a]; }
+    if (b < b_end) { b_key = keys_src[b]; }
+
+    let n = min(VT, count - first);
+    for (var i = 0u; i < n; i++) {
+      let take_a = b >= b_end || (a < a_end && !(b_key < a_key));
+      if (take_a) {
+        keys_dst[first + i] = a_key;
+        a++;
+        if (a < a_end) { a_key = keys_src[a]; }
+      } else {
+        keys_dst[first + i] = b_key;
+        b++;
+        if (b < b_end) { b_key = keys_src[b]; }
+      }
+    }
+  }
+)"
@@ -1,55 +1,155 @@
-
-
 R"(
   enable subgroups;
 
   struct UniformData {
     count: u32,
-    step: u32,
+    width: u32,
   }
 
+#if IN_PLACE
+  // The block pass sorts the tiles in place when no merge pass follows it or
+  // the merge passes end up back in the input.
   @binding(0) @group(0) var<storage, read_write> data: array<u32>;
-  @binding(1) @group(0) var<uniform> uniforms: UniformData;
-  
+  @binding(2) @group(0) var<uniform> uniforms: UniformData;
+
+  fn store_key(i: u32, key: u32) {
+    data[i] = key;
+  }
+#else
+  @binding(0) @group(0) var<storage, read> data: array<u32>;
+  @binding(1) @group(0) var<storage, read_write> data_out: array<u32>;
+  @binding(2) @group(0) var<uniform> uniforms: UniformData;
+
+  fn store_key(i: u32, key: u32) {
+    data_out[i] = key;
+  }
+#endif
+
   fn getLaneMaskLt(idx: u32) -> u32 {
       return (1u << idx) - 1u;
   }
 
-  const WG_SIZE = 32u;
+  const SG_SIZE = 32u;
+  const WG_SIZE = 256u;
+  const KEYS_PER_THREAD = 4u;
+  const TILE_SIZE = WG_SIZE * KEYS_PER_THREAD;
+
+  // Two tiles, merge passes ping-pong between the halves.
+  var<workgroup> shared_mem: array<u32, 2048>;
+
+  // Rank of key among the keys of this subgroup, ties are broken by lane so the
+  // resulting order is stable.
+  fn ballot_rank(key: u32, sg_id: u32) -> u32 {
+    var geMask = getLaneMaskLt(sg_id);
+
+    for (var bit = 0u; bit < 32u; bit++) {
+        let currentBit = 1u << bit;
+        let isBitNotSet = (key & currentBit) == 0u;
+        let ballot = subgroupBallot2(isBitNotSet)[0u];
+
+        if (isBitNotSet) {
+            geMask &= ballot;
+        } else {
+            geMask |= ballot;
+        }
+    }
+
+    return countOneBits(geMask);
+  }
+
+  // Number of keys in the sorted run that are < key.
+  fn lower_bound(begin: u32, count: u32, key: u32) -> u32 {
+    var lo = 0u;
+    var hi = count;
+    loop {
+      if (lo >= hi) {
+        break;
+      }
+      let mid = (lo + hi) / 2u;
+      if (shared_mem[begin + mid] < key) {
+        lo = mid + 1u;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  // Number of keys in the sorted run that are <= key.
+  fn upper_bound(begin: u32, count: u32, key: u32) -> u32 {
+    var lo = 0u;
+    var hi = count;
+    loop {
+      if (lo >= hi) {
+        break;
+      }
+      let mid = (lo + hi) / 2u;
+      if (shared_mem[begin + mid] <= key) {
+        lo = mid + 1u;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
 
-  var<workgroup> shared_mem: array<u32, 32>;
- 
   @compute @workgroup_size(WG_SIZE, 1, 1)
   fn main(
-    @builtin(global_invocation_id) global_invocation_id: vec3<u32>,
     @builtin(local_invocation_id) local_id: vec3<u32>,
     @builtin(workgroup_id) wg_id: vec3<u32>,
+    @builtin(num_workgroups) num_wgs: vec3<u32>,
     @builtin(subgroup_size) sg_size : u32,
     @builtin(subgroup_invocation_id) sg_id : u32
   ) {
-    let base = (wg_id.y * uniforms.step + wg_id.x) * WG_SIZE;
+    let base = (wg_id.y * num_wgs.x + wg_id.x) * TILE_SIZE;
     if (base >= uniforms.count) {
        return;
     }
 
-    var geMask = getLaneMaskLt(sg_id);
-    let key = data[global_invocation_id.x];
+    let tid = local_id.x;
+    // Each subgroup sorts runs of 32 consecutive keys. Keys past the end are
+    // padded with the largest key and never written back.
+    let run = tid - sg_id;
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = k * WG_SIZE + tid;
+      var key = 0xffffffffu;
+      if (base + i < uniforms.count) {
+        key = data[base + i];
+      }
+      let rank = ballot_rank(key, sg_id);
+      shared_mem[k * WG_SIZE + run + rank] = key;
+    }
+    workgroupBarrier();
 
-    for (var bit = 0u; bit < 32u; bit++) {
-        let currentBit = 1u << bit;
-        let isBitNotSet = (key & currentBit) == 0u;
-        let ballot = subgroupBallot2(isBitNotSet)[0u];
-        
-        if (isBitNotSet) {
-            geMask &= ballot;
+    // Merge pairs of runs until the tile is sorted. Every key finds its output
+    // position from its rank in the sibling run, keys of the left run go first
+    // on ties.
+    var src = 0u;
+    for (var width = SG_SIZE; width < TILE_SIZE; width = width * 2u) {
+      let dst = TILE_SIZE - src;
+      for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+        let i = k * WG_SIZE + tid;
+        let key = shared_mem[src + i];
+        let pair = i & ~(2u * width - 1u);
+        let local_index = i & (width - 1u);
+
+        var pos: u32;
+        if ((i & width) != 0u) {
+          pos = local_index + upper_bound(src + pair, width, key);
         } else {
-            geMask |= ballot;
+          pos = local_index + lower_bound(src + pair + width, width, key);
         }
+        shared_mem[dst + pair + pos] = key;
+      }
+      workgroupBarrier();
+      src = dst;
     }
 
-    let scatterTo = countOneBits(geMask);
-    data[base + scatterTo] = key;    
+    for (var k = 0u; k < KEYS_PER_THREAD; k++) {
+      let i = k * WG_SIZE + tid;
+      if (base + i < uniforms.count) {
+        store_key(base + i, shared_mem[src + i]);
+      }
+    }
   }
 )"
-
-
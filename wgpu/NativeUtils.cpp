@@ -2,6 +2,8 @@
 
 #include <iostream>
 
+#include "../PipelineCache.h"
+
 static WGPUDevice backendDevice;
 static DawnProcTable backendProcs;
 
@@ -84,7 +86,7 @@ wgpu::Adapter SetupAdapter(const std::unique_ptr<wgpu::Instance>& instance) {
     return adapter;
 }
 
-wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Adapter& adapter) {
+wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Adapter& adapter, PipelineCache* cache) {
     if (adapter == nullptr) {
         std::cerr << "Failed to create adapter" << std::endl;
         exit(1);
@@ -98,14 +100,29 @@ wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const
     wgpu::DeviceDescriptor deviceDesc;
     deviceDesc.uncapturedErrorCallbackInfo = {nullptr, PrintDeviceError, nullptr};
     deviceDesc.deviceLostCallbackInfo = {nullptr, wgpu::CallbackMode::AllowSpontaneous, PrintDeviceLoss, nullptr};
+    if (cache) {
+        cache->Attach(deviceDesc);
+    }
 
     std::vector<wgpu::FeatureName> requiredFeatures = {wgpu::FeatureName::TimestampQuery, wgpu::FeatureName::Subgroups};
+    // ReadbackPool finishes its reads on an event thread only with this feature.
+    if (adapter.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization)) {
+        requiredFeatures.push_back(wgpu::FeatureName::ImplicitDeviceSynchronization);
+    }
     deviceDesc.requiredFeatures = requiredFeatures.data();
     deviceDesc.requiredFeatureCount = requiredFeatures.size();
 
+    wgpu::SupportedLimits adapterLimits;
+    adapter.GetLimits(&adapterLimits);
+
     wgpu::RequiredLimits limits;
     limits.nextInChain = nullptr;
     limits.limits.maxStorageBuffersPerShaderStage = 10;
+    // Wide sort records (e.g. 64 bit keys with a payload) need more than the default 16KB,
+    // and SegmentedSort derives its tile from these, see SegmentedSortBase::LargestTile.
+    limits.limits.maxComputeWorkgroupStorageSize = adapterLimits.limits.maxComputeWorkgroupStorageSize;
+    limits.limits.maxComputeInvocationsPerWorkgroup = adapterLimits.limits.maxComputeInvocationsPerWorkgroup;
+    limits.limits.maxComputeWorkgroupSizeX = adapterLimits.limits.maxComputeWorkgroupSizeX;
     limits.limits.maxBufferSize = 1u << 30u;
     limits.limits.maxStorageBufferBindingSize = 1u << 30u;
     deviceDesc.requiredLimits = &limits;
@@ -130,6 +147,8 @@ wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const
     device.GetLimits(&supportedLimits);
 
     std::cout << "Supported: " << supportedLimits.limits.maxBufferSize << " " << supportedLimits.limits.maxStorageBufferBindingSize << std::endl;
+    std::cout << "Workgroup storage: " << supportedLimits.limits.maxComputeWorkgroupStorageSize
+              << " invocations: " << supportedLimits.limits.maxComputeInvocationsPerWorkgroup << std::endl;
 
     return device;
 }
@@ -13,7 +13,10 @@
 
 void DumpAllInfo();
 
+class PipelineCache;
+
 namespace NativeUtils {
-wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Adapter& adapter);
+// With a cache the device loads and stores its compiled shaders through it.
+wgpu::Device SetupDevice(const std::unique_ptr<wgpu::Instance>& instance, const wgpu::Adapter& adapter, PipelineCache* cache = nullptr);
 wgpu::Adapter SetupAdapter(const std::unique_ptr<wgpu::Instance>& instance);
 }  // namespace NativeUtils
\ No newline at end of file